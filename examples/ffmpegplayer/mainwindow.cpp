@@ -419,6 +419,7 @@ void MainWindow::onRenderChanged(QAction *action)
     videoRender->widget()->setAcceptDrops(true);
     videoRender->widget()->installEventFilter(this);
     d_ptr->playerPtr->setVideoRenders({videoRender});
+    d_ptr->playerPtr->setDisplayRefreshRate(screen()->refreshRate());
     d_ptr->splitter->insertWidget(0, videoRender->widget());
     // 为什么切换成widget还是有使用GPU 0-3D，而且使用量是切换为opengl的两倍！！！
     d_ptr->videoRender.reset(videoRender);
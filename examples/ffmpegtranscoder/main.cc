@@ -3,6 +3,8 @@
 #include <3rdparty/qtsingleapplication/qtsingleapplication.h>
 #include <dump/crashpad.hpp>
 #include <examples/appinfo.hpp>
+#include <ffmpeg/keyframeindex.hpp>
+#include <ffmpeg/thumbnailcache.hpp>
 #include <utils/hostosinfo.h>
 #include <utils/logasync.h>
 #include <utils/utils.hpp>
@@ -83,6 +85,8 @@ auto main(int argc, char *argv[]) -> int
 
     qInfo().noquote() << "\n\n" + Utils::systemInfo() + "\n\n";
     Utils::setPixmapCacheLimit();
+    Ffmpeg::ThumbnailCache::instance()->setDiskCachePath(Utils::cachePath() + "/thumbnails");
+    Ffmpeg::KeyFrameIndexer::instance()->setCachePath(Utils::cachePath() + "/keyframes");
 
     // Make sure we honor the system's proxy settings
     QNetworkProxyFactory::setUseSystemConfiguration(true);
@@ -273,6 +273,12 @@ void MainWindow::onProcessEvents()
         case Ffmpeg::PropertyChangeEvent::EventType::PreviewFramesChanged:
             d_ptr->previewWidget->setFrames(d_ptr->transcoder->previewFrames());
             break;
+        case Ffmpeg::PropertyChangeEvent::EventType::PreviewFrame: {
+            auto *previewFrameEvent = dynamic_cast<Ffmpeg::PreviewFrameEvent *>(eventPtr.data());
+            d_ptr->previewWidget->setFrame(previewFrameEvent->index(),
+                                           previewFrameEvent->count(),
+                                           previewFrameEvent->frame());
+        } break;
         case Ffmpeg::PropertyChangeEvent::EventType::AVError: {
             auto *errorEvent = dynamic_cast<Ffmpeg::AVErrorEvent *>(eventPtr.data());
             const auto text = tr("Error[%1]:%2.")
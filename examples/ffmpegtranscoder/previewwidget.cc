@@ -29,14 +29,22 @@ public:
     {
         Q_ASSERT(index >= 0 && index < framePtrs.size());
         frameIndex = index;
-        renderPtr->setFrame(framePtrs[frameIndex]);
-        auto currentTime = QTime::fromMSecsSinceStartOfDay(framePtrs[frameIndex]->pts() / 1000)
-                               .toString("hh:mm:ss.zzz");
-        infoLabel->setText(QCoreApplication::translate("PreviewWidgetPrivate",
-                                                       "Source Preview: %1 / %2, Position: %3")
-                               .arg(QString::number(frameIndex + 1),
-                                    QString::number(framePtrs.size()),
-                                    currentTime));
+        const auto &framePtr = framePtrs[frameIndex];
+        if (nullptr == framePtr) {
+            infoLabel->setText(QCoreApplication::translate("PreviewWidgetPrivate",
+                                                           "Source Preview: %1 / %2, Loading...")
+                                   .arg(QString::number(frameIndex + 1),
+                                        QString::number(framePtrs.size())));
+        } else {
+            renderPtr->setFrame(framePtr);
+            auto currentTime = QTime::fromMSecsSinceStartOfDay(framePtr->pts() / 1000)
+                                   .toString("hh:mm:ss.zzz");
+            infoLabel->setText(QCoreApplication::translate("PreviewWidgetPrivate",
+                                                           "Source Preview: %1 / %2, Position: %3")
+                                   .arg(QString::number(frameIndex + 1),
+                                        QString::number(framePtrs.size()),
+                                        currentTime));
+        }
 
         leftButton->setEnabled(frameIndex != 0);
         rightButton->setEnabled(frameIndex != (framePtrs.size() - 1));
@@ -65,9 +73,27 @@ PreviewWidget::~PreviewWidget() = default;
 
 void PreviewWidget::setFrames(const Ffmpeg::FramePtrList &framePtrs)
 {
+    if (framePtrs.empty()) {
+        return;
+    }
+    // the same strip as the streamed frames keeps the current one
+    auto index = d_ptr->framePtrs.size() == framePtrs.size() ? d_ptr->frameIndex : 1;
     d_ptr->framePtrs = framePtrs;
-    d_ptr->frameIndex = 2;
-    onPerFrame();
+    d_ptr->setCurrentFrame(qBound(0, index, static_cast<int>(framePtrs.size()) - 1));
+}
+
+void PreviewWidget::setFrame(int index, int count, const Ffmpeg::FramePtr &framePtr)
+{
+    Q_ASSERT(index >= 0 && index < count);
+    auto reset = d_ptr->framePtrs.size() != static_cast<size_t>(count);
+    if (reset) {
+        d_ptr->framePtrs.assign(count, nullptr);
+        d_ptr->frameIndex = qMin(1, count - 1);
+    }
+    d_ptr->framePtrs[index] = framePtr;
+    if (reset || index == d_ptr->frameIndex) {
+        d_ptr->setCurrentFrame(d_ptr->frameIndex);
+    }
 }
 
 void PreviewWidget::onPerFrame()
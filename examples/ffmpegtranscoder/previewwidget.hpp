@@ -12,6 +12,8 @@ public:
     ~PreviewWidget() override;
 
     void setFrames(const Ffmpeg::FramePtrList &framePtrs);
+    // while the previews are generated, null until decoded
+    void setFrame(int index, int count, const Ffmpeg::FramePtr &framePtr);
 
 private slots:
     void onPerFrame();
@@ -0,0 +1,282 @@
+#include "job.hpp"
+
+#include <QCommandLineParser>
+#include <QJsonArray>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+
+// "1280x720"
+auto sizeFromString(const QString &text) -> QSize
+{
+    auto list = text.split('x', Qt::SkipEmptyParts, Qt::CaseInsensitive);
+    if (list.size() != 2) {
+        return {-1, -1};
+    }
+    bool widthOk = false;
+    bool heightOk = false;
+    QSize size(list.at(0).toInt(&widthOk), list.at(1).toInt(&heightOk));
+    if (!widthOk || !heightOk || size.isEmpty()) {
+        return {-1, -1};
+    }
+    return size;
+}
+
+// "output,1280x720,3000000", the size and the bitrate are optional
+auto renditionFromString(const QString &text, RenditionOptions &rendition) -> bool
+{
+    auto list = text.split(',');
+    rendition.output = list.takeFirst().trimmed();
+    if (rendition.output.isEmpty()) {
+        return false;
+    }
+    if (!list.isEmpty()) {
+        auto sizeText = list.takeFirst().trimmed();
+        if (!sizeText.isEmpty()) {
+            rendition.video.size = sizeFromString(sizeText);
+            if (!rendition.video.size.isValid()) {
+                return false;
+            }
+        }
+    }
+    if (!list.isEmpty()) {
+        bool ok = false;
+        rendition.video.bitrate = list.takeFirst().trimmed().toLongLong(&ok);
+        if (!ok) {
+            return false;
+        }
+    }
+    return list.isEmpty();
+}
+
+} // namespace
+
+void StreamOptions::fromJson(const QJsonObject &object)
+{
+    encoder = object.value("encoder").toString(encoder);
+    if (object.contains("size")) {
+        size = sizeFromString(object.value("size").toString());
+    }
+    bitrate = object.value("bitrate").toInteger(bitrate);
+    crf = object.value("crf").toInt(crf);
+    preset = object.value("preset").toString(preset);
+    tune = object.value("tune").toString(tune);
+    sampleRate = object.value("sampleRate").toInt(sampleRate);
+    threadCount = object.value("threadCount").toInt(threadCount);
+}
+
+auto StreamOptions::apply(Ffmpeg::EncodeContext &encodeContext) const -> bool
+{
+    if (encoder == "none") {
+        encodeContext.streamIndex = -1;
+        return true;
+    }
+    if (!encoder.isEmpty()) {
+        const auto *codec = avcodec_find_encoder_by_name(encoder.toUtf8().constData());
+        if (codec == nullptr || codec->type != encodeContext.mediaType
+            || !encodeContext.setEncoderName(encoder)) {
+            qWarning() << "Unsupported encoder:" << encoder;
+            return false;
+        }
+    }
+    if (size.isValid()) {
+        encodeContext.size = size;
+    }
+    if (bitrate > 0) {
+        encodeContext.bitrate = bitrate;
+    }
+    if (crf != Ffmpeg::EncodeLimit::invalid_crf) {
+        encodeContext.crf = crf;
+    }
+    if (!preset.isEmpty()) {
+        encodeContext.preset = preset;
+    }
+    if (!tune.isEmpty()) {
+        encodeContext.tune = tune;
+    }
+    if (sampleRate > 0) {
+        encodeContext.sampleRate = sampleRate;
+    }
+    if (threadCount > 0) {
+        encodeContext.threadCount = threadCount;
+    }
+    return true;
+}
+
+auto Job::fromJson(const QJsonObject &object, QString *errorString) -> bool
+{
+    input = object.value("input").toString(input);
+    output = object.value("output").toString(output);
+    subtitle = object.value("subtitle").toString(subtitle);
+    gpuDecode = object.value("gpuDecode").toBool(gpuDecode);
+
+    start = object.value("start").toDouble(start);
+    end = object.value("end").toDouble(end);
+    smartCut = object.value("smartCut").toBool(smartCut);
+
+    segmentCount = object.value("segmentCount").toInt(segmentCount);
+    segmentDuration = object.value("segmentDuration").toDouble(segmentDuration);
+
+    muxQueueSize = object.value("muxQueueSize").toInt(muxQueueSize);
+    ioBufferSize = object.value("ioBufferSize").toInt(ioBufferSize);
+
+    video.fromJson(object.value("video").toObject());
+    audio.fromJson(object.value("audio").toObject());
+
+    const auto array = object.value("renditions").toArray();
+    for (const auto &value : array) {
+        auto renditionObject = value.toObject();
+        RenditionOptions rendition;
+        rendition.output = renditionObject.value("output").toString();
+        if (rendition.output.isEmpty()) {
+            *errorString = QString("Rendition %1 has no output.").arg(renditions.size());
+            return false;
+        }
+        rendition.video.fromJson(renditionObject.value("video").toObject());
+        rendition.audio.fromJson(renditionObject.value("audio").toObject());
+        renditions.append(rendition);
+    }
+    return true;
+}
+
+auto Job::fromCommandLine(const QCommandLineParser &parser, QString *errorString) -> bool
+{
+    auto toDouble = [&](const QString &name, double &value) {
+        if (!parser.isSet(name)) {
+            return true;
+        }
+        bool ok = false;
+        value = parser.value(name).toDouble(&ok);
+        if (!ok) {
+            *errorString = QString("Invalid --%1: %2.").arg(name, parser.value(name));
+        }
+        return ok;
+    };
+    auto toInt = [&](const QString &name, auto &value) {
+        if (!parser.isSet(name)) {
+            return true;
+        }
+        bool ok = false;
+        value = parser.value(name).toLongLong(&ok);
+        if (!ok) {
+            *errorString = QString("Invalid --%1: %2.").arg(name, parser.value(name));
+        }
+        return ok;
+    };
+    auto toString = [&](const QString &name, QString &value) {
+        if (parser.isSet(name)) {
+            value = parser.value(name);
+        }
+    };
+
+    const auto positionalArguments = parser.positionalArguments();
+    if (!positionalArguments.isEmpty()) {
+        input = positionalArguments.at(0);
+    }
+    if (positionalArguments.size() > 1) {
+        output = positionalArguments.at(1);
+    }
+    toString("subtitle", subtitle);
+    if (parser.isSet("no-gpu")) {
+        gpuDecode = false;
+    }
+    if (parser.isSet("smart-cut")) {
+        smartCut = true;
+    }
+    if (!toDouble("start", start) || !toDouble("end", end)
+        || !toInt("segments", segmentCount) || !toDouble("segment-duration", segmentDuration)
+        || !toInt("mux-queue-size", muxQueueSize) || !toInt("io-buffer-size", ioBufferSize)) {
+        return false;
+    }
+
+    toString("video-encoder", video.encoder);
+    if (parser.isSet("size")) {
+        video.size = sizeFromString(parser.value("size"));
+        if (!video.size.isValid()) {
+            *errorString = QString("Invalid --size: %1.").arg(parser.value("size"));
+            return false;
+        }
+    }
+    toString("preset", video.preset);
+    toString("tune", video.tune);
+    toString("audio-encoder", audio.encoder);
+    if (!toInt("video-bitrate", video.bitrate) || !toInt("crf", video.crf)
+        || !toInt("audio-bitrate", audio.bitrate) || !toInt("sample-rate", audio.sampleRate)) {
+        return false;
+    }
+
+    const auto values = parser.values("rendition");
+    for (const auto &value : values) {
+        RenditionOptions rendition;
+        if (!renditionFromString(value, rendition)) {
+            *errorString = QString("Invalid --rendition: %1.").arg(value);
+            return false;
+        }
+        renditions.append(rendition);
+    }
+    return true;
+}
+
+auto Job::encodeContexts(const Ffmpeg::EncodeContexts &decodeContexts,
+                         Ffmpeg::EncodeContexts &contexts,
+                         int rendition) const -> bool
+{
+    contexts = decodeContexts;
+    for (auto &encodeContext : contexts) {
+        QList<const StreamOptions *> optionsList;
+        switch (encodeContext.mediaType) {
+        case AVMEDIA_TYPE_VIDEO:
+            optionsList.append(&video);
+            if (rendition >= 0) {
+                optionsList.append(&renditions.at(rendition).video);
+            }
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            optionsList.append(&audio);
+            if (rendition >= 0) {
+                optionsList.append(&renditions.at(rendition).audio);
+            }
+            break;
+        default: break;
+        }
+        for (const auto *options : std::as_const(optionsList)) {
+            if (!options->apply(encodeContext)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void addJobOptions(QCommandLineParser &parser)
+{
+    parser.addPositionalArgument("input", "Input file or url.", "[input]");
+    parser.addPositionalArgument("output", "Output file.", "[output]");
+    parser.addOptions({
+        {{"j", "job"}, "Transcode job file (JSON), the options override it.", "file"},
+        {"subtitle", "Subtitle file burnt into the video.", "file"},
+        {"no-gpu", "Decode on the cpu."},
+        {"start", "Range start.", "second"},
+        {"end", "Range end, until the end of the input if not set.", "second"},
+        {"smart-cut", "Copy the whole GOPs inside the range."},
+        {"segments", "Encode the video in parallel segments.", "count"},
+        {"segment-duration", "Duration of the parallel segments.", "second"},
+        {"mux-queue-size", "Packets queued per output.", "count"},
+        {"io-buffer-size", "Write buffer per output.", "bytes"},
+        {"video-encoder", "Video encoder, none drops the video.", "name"},
+        {"size", "Video size.", "WxH"},
+        {"video-bitrate", "Video bitrate.", "bps"},
+        {"crf", "Video crf.", "value"},
+        {"preset", "Video encoder preset.", "name"},
+        {"tune", "Video encoder tune.", "name"},
+        {"audio-encoder", "Audio encoder, none drops the audio.", "name"},
+        {"audio-bitrate", "Audio bitrate.", "bps"},
+        {"sample-rate", "Audio sample rate.", "hz"},
+        {"rendition",
+         "Extra output from the same decode, may be repeated.",
+         "output[,WxH[,bps]]"},
+    });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <ffmpeg/encodecontext.hpp>
+
+#include <QJsonObject>
+
+class QCommandLineParser;
+
+// encoder settings of one media type, unset fields keep the source values
+struct StreamOptions
+{
+    void fromJson(const QJsonObject &object);
+    // "none" drops the streams of the type
+    auto apply(Ffmpeg::EncodeContext &encodeContext) const -> bool;
+
+    QString encoder;
+    QSize size = {-1, -1};
+    qint64 bitrate = -1;
+    int crf = Ffmpeg::EncodeLimit::invalid_crf;
+    QString preset;
+    QString tune;
+    int sampleRate = -1;
+    int threadCount = -1;
+};
+
+struct RenditionOptions
+{
+    QString output;
+    StreamOptions video;
+    StreamOptions audio;
+};
+
+struct Job
+{
+    // the command line overrides the job file
+    auto fromJson(const QJsonObject &object, QString *errorString) -> bool;
+    auto fromCommandLine(const QCommandLineParser &parser, QString *errorString) -> bool;
+
+    // of the main output, or of a rendition on top of the main output's options
+    auto encodeContexts(const Ffmpeg::EncodeContexts &decodeContexts,
+                        Ffmpeg::EncodeContexts &contexts,
+                        int rendition = -1) const -> bool;
+
+    QString input;
+    QString output;
+    QString subtitle;
+    bool gpuDecode = true;
+
+    double start = 0; // second
+    double end = 0;   // second, <= 0 until the end
+    bool smartCut = false;
+
+    int segmentCount = 0;
+    double segmentDuration = 0; // second
+
+    int muxQueueSize = -1;
+    int ioBufferSize = 0;
+
+    StreamOptions video;
+    StreamOptions audio;
+    QList<RenditionOptions> renditions;
+};
+
+void addJobOptions(QCommandLineParser &parser);
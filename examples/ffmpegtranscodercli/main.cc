@@ -0,0 +1,334 @@
+#include "job.hpp"
+
+#include <examples/appinfo.hpp>
+#include <ffmpeg/event/errorevent.hpp>
+#include <ffmpeg/event/valueevent.hpp>
+#include <ffmpeg/keyframeindex.hpp>
+#include <ffmpeg/transcoder.hpp>
+#include <utils/logasync.h>
+#include <utils/utils.hpp>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTimer>
+
+#include <csignal>
+
+#define AppName "FfmpegTranscoderCli"
+
+// exit codes for scripts
+enum ExitCode : int {
+    Success = 0,
+    TranscodeFailed = 1,
+    UsageError = 2,
+    InputFailed = 3,
+    Interrupted = 130
+};
+
+static std::atomic_bool g_interrupted = false;
+
+void setAppInfo()
+{
+    qApp->setApplicationVersion(AppInfo::version.toString());
+    qApp->setApplicationName(AppName);
+    qApp->setOrganizationDomain(AppInfo::organizationDomain);
+    qApp->setOrganizationName(AppInfo::organzationName);
+}
+
+auto fileSize(const QString &filePath) -> qint64
+{
+    QFileInfo fileInfo(filePath);
+    return fileInfo.isFile() ? fileInfo.size() : -1;
+}
+
+struct Session
+{
+    Ffmpeg::Transcoder *transcoder = nullptr;
+    Job job;
+
+    bool started = false;
+    bool quiet = false;
+    int progressInterval = 500; // milliseconds
+    QElapsedTimer wallTimer;
+    QElapsedTimer progressTimer;
+    qint64 position = 0; // microsecond
+    QPair<qint64, qint64> range; // microsecond
+    QStringList errors;
+    ExitCode exitCode = Success;
+    bool finished = false;
+    QJsonObject result;
+
+    [[nodiscard]] auto rangeDuration() const -> qint64 { return range.second - range.first; }
+
+    auto start() -> bool
+    {
+        auto decodeContexts = transcoder->decodeContexts();
+        Ffmpeg::EncodeContexts encodeContexts;
+        if (!job.encodeContexts(decodeContexts, encodeContexts)) {
+            return false;
+        }
+        transcoder->setEncodeContexts(encodeContexts);
+        transcoder->clearRenditions();
+        for (int i = 0; i < job.renditions.size(); i++) {
+            if (!job.encodeContexts(decodeContexts, encodeContexts, i)) {
+                return false;
+            }
+            transcoder->addRendition(job.renditions.at(i).output, encodeContexts);
+        }
+
+        auto duration = transcoder->duration();
+        range.first = qBound<qint64>(0, job.start * AV_TIME_BASE, duration);
+        range.second = job.end > 0 ? qBound<qint64>(range.first, job.end * AV_TIME_BASE, duration)
+                                   : duration;
+        transcoder->setRange(range);
+        transcoder->setSmartCut(job.smartCut);
+        transcoder->setSegmentCount(job.segmentCount);
+        transcoder->setSegmentDuration(job.segmentDuration * AV_TIME_BASE);
+        if (job.muxQueueSize > 0) {
+            transcoder->setMuxQueueSize(job.muxQueueSize);
+        }
+        transcoder->setIoBufferSize(job.ioBufferSize);
+        if (!job.subtitle.isEmpty()) {
+            transcoder->setSubtitleFilename(job.subtitle);
+        }
+
+        started = true;
+        wallTimer.start();
+        progressTimer.start();
+        transcoder->startTranscode();
+        return true;
+    }
+
+    void printProgress(bool force = false)
+    {
+        if (quiet || (!force && progressTimer.elapsed() < progressInterval)) {
+            return;
+        }
+        progressTimer.restart();
+        auto done = qBound<qint64>(0, position - range.first, rangeDuration());
+        auto progress = rangeDuration() > 0 ? done * 100.0 / rangeDuration() : 0.0;
+        auto elapsed = wallTimer.elapsed();
+        auto speed = elapsed > 0 ? done / 1000.0 / elapsed : 0.0;
+        fprintf(stderr,
+                "progress=%.1f%% time=%s fps=%.1f speed=%.2fx write=%s/s queue=%d\n",
+                progress,
+                QTime::fromMSecsSinceStartOfDay(done / 1000)
+                    .toString("hh:mm:ss.zzz")
+                    .toLocal8Bit()
+                    .constData(),
+                transcoder->fps(),
+                speed,
+                Utils::formatBytes(transcoder->writeSpeed()).toLocal8Bit().constData(),
+                transcoder->muxQueueDepth());
+    }
+
+    void addError(const QString &text)
+    {
+        errors.append(text);
+        fprintf(stderr, "%s\n", text.toLocal8Bit().constData());
+    }
+
+    void processEvents()
+    {
+        while (transcoder->propertyChangeEventSize() > 0) {
+            auto eventPtr = transcoder->takePropertyChangeEvent();
+            switch (eventPtr->type()) {
+            case Ffmpeg::PropertyChangeEvent::EventType::Position: {
+                auto *positionEvent = dynamic_cast<Ffmpeg::PositionEvent *>(eventPtr.data());
+                position = qMax(position, positionEvent->position());
+                printProgress();
+            } break;
+            case Ffmpeg::PropertyChangeEvent::EventType::MediaTrack:
+                if (!started && !start()) {
+                    finish(UsageError);
+                }
+                break;
+            case Ffmpeg::PropertyChangeEvent::EventType::AVError: {
+                auto *errorEvent = dynamic_cast<Ffmpeg::AVErrorEvent *>(eventPtr.data());
+                addError(QString("Error[%1]:%2.")
+                             .arg(QString::number(errorEvent->error().errorCode()),
+                                  errorEvent->error().errorString()));
+                // a decode, encode or write failure of the running transcode, the output is not
+                // trustworthy even if the transcoder goes on
+                if (started && exitCode == Success) {
+                    exitCode = TranscodeFailed;
+                }
+            } break;
+            case Ffmpeg::PropertyChangeEvent::EventType::Error: {
+                auto *errorEvent = dynamic_cast<Ffmpeg::ErrorEvent *>(eventPtr.data());
+                addError(QString("Error:%1.").arg(errorEvent->error()));
+                // fatal, the transcoder stops on its own
+                if (!started) {
+                    finish(InputFailed);
+                } else if (exitCode == Success) {
+                    exitCode = TranscodeFailed;
+                }
+            } break;
+            default: break;
+            }
+        }
+    }
+
+    [[nodiscard]] auto summary() const -> QJsonObject
+    {
+        auto wallTime = wallTimer.isValid() ? wallTimer.elapsed() / 1000.0 : 0.0;
+        auto duration = rangeDuration() / double(AV_TIME_BASE);
+        auto frames = transcoder->frameCount();
+
+        QJsonArray outputs;
+        qint64 bytesOut = 0;
+        QStringList outputPaths{job.output};
+        for (const auto &rendition : std::as_const(job.renditions)) {
+            outputPaths.append(rendition.output);
+        }
+        for (const auto &path : std::as_const(outputPaths)) {
+            auto size = fileSize(path);
+            bytesOut += qMax<qint64>(size, 0);
+            outputs.append(QJsonObject{{"path", path}, {"bytes", size}});
+        }
+
+        QJsonObject stages;
+        const auto stageTimes = transcoder->stageTimes();
+        for (auto iter = stageTimes.cbegin(); iter != stageTimes.cend(); ++iter) {
+            stages.insert(iter.key(), iter.value() / double(AV_TIME_BASE));
+        }
+
+        return {{"status",
+                 exitCode == Success       ? "success"
+                 : exitCode == Interrupted ? "interrupted"
+                                           : "failed"},
+                {"exitCode", exitCode},
+                {"input", job.input},
+                {"outputs", outputs},
+                {"duration", duration},
+                {"wallTime", wallTime},
+                {"speed", wallTime > 0 ? duration / wallTime : 0.0},
+                {"frames", frames},
+                {"fps", wallTime > 0 ? frames / wallTime : 0.0},
+                {"bytesIn", fileSize(job.input)},
+                {"bytesOut", bytesOut},
+                {"stageTimes", stages},
+                {"errors", QJsonArray::fromStringList(errors)}};
+    }
+
+    // before stopTranscode(), which resets the statistics
+    void finish(ExitCode code)
+    {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        if (exitCode == Success) {
+            exitCode = code;
+        }
+        result = summary();
+        QCoreApplication::exit(exitCode);
+    }
+};
+
+auto main(int argc, char *argv[]) -> int
+{
+    QCoreApplication app(argc, argv);
+    setAppInfo();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Transcode a media file with the ffmpeg pipeline, print the "
+                                     "progress to stderr and a JSON summary to stdout.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    addJobOptions(parser);
+    parser.addOptions({
+        {"summary", "Write the summary to a file instead of stdout.", "file"},
+        {"progress-interval", "Progress report interval.", "milliseconds", "500"},
+        {{"q", "quiet"}, "No progress report."},
+        {{"v", "verbose"}, "Log to the console as well."},
+    });
+    parser.process(app);
+
+    Session session;
+    QString errorString;
+    if (parser.isSet("job")) {
+        auto object = Utils::jsonFromFile(parser.value("job"));
+        if (object.isEmpty()) {
+            errorString = QString("Invalid job file: %1.").arg(parser.value("job"));
+        } else {
+            session.job.fromJson(object, &errorString);
+        }
+    }
+    if (errorString.isEmpty()) {
+        session.job.fromCommandLine(parser, &errorString);
+    }
+    if (errorString.isEmpty() && (session.job.input.isEmpty() || session.job.output.isEmpty())) {
+        errorString = "Input and output are required.";
+    }
+    if (!errorString.isEmpty()) {
+        fprintf(stderr, "%s\n\n%s", errorString.toLocal8Bit().constData(),
+                parser.helpText().toLocal8Bit().constData());
+        return UsageError;
+    }
+    session.quiet = parser.isSet("quiet");
+    session.progressInterval = qMax(0, parser.value("progress-interval").toInt());
+
+    // stdout is kept for the summary
+    auto *log = Utils::LogAsync::instance();
+    log->setLogPath(Utils::logPath());
+    log->setAutoDelFile(true);
+    log->setAutoDelFileDays(7);
+    log->setOrientation(parser.isSet("verbose") ? Utils::LogAsync::Orientation::StandardAndFile
+                                                : Utils::LogAsync::Orientation::File);
+    log->setLogLevel(QtDebugMsg);
+    log->startWork();
+
+    qInfo().noquote() << "\n\n" + Utils::systemInfo() + "\n\n";
+    Ffmpeg::KeyFrameIndexer::instance()->setCachePath(Utils::cachePath() + "/keyframes");
+
+    Ffmpeg::Transcoder transcoder;
+    session.transcoder = &transcoder;
+    QObject::connect(&transcoder, &Ffmpeg::Transcoder::eventIncrease, &app, [&session] {
+        session.processEvents();
+    });
+    QObject::connect(&transcoder, &Ffmpeg::Transcoder::finished, &app, [&session] {
+        session.processEvents();
+        session.printProgress(true);
+        session.finish(g_interrupted.load() ? Interrupted : Success);
+    });
+
+    std::signal(SIGINT, [](int) { g_interrupted.store(true); });
+    std::signal(SIGTERM, [](int) { g_interrupted.store(true); });
+    QTimer interruptTimer;
+    QObject::connect(&interruptTimer, &QTimer::timeout, &app, [&] {
+        if (!g_interrupted.load()) {
+            return;
+        }
+        interruptTimer.stop();
+        session.finish(Interrupted);
+    });
+    interruptTimer.start(100);
+
+    transcoder.setInFilePath(session.job.input);
+    transcoder.setOutFilePath(session.job.output);
+    transcoder.setGpuDecode(session.job.gpuDecode);
+    transcoder.parseInputFile();
+
+    auto ret = app.exec();
+    transcoder.stopTranscode();
+
+    auto document = QJsonDocument(session.result).toJson();
+    if (parser.isSet("summary")) {
+        QFile file(parser.value("summary"));
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(document);
+        } else {
+            fprintf(stderr, "Cannot open the file: %s\n", qUtf8Printable(file.fileName()));
+        }
+    } else {
+        fprintf(stdout, "%s", document.constData());
+    }
+    log->stop();
+    return ret;
+}
@@ -3,36 +3,24 @@
 #include "avcontextinfo.h"
 #include "ffmpegutils.hpp"
 
-#include <event/seekevent.hpp>
-
-#include <QDebug>
-
 namespace Ffmpeg {
 
 class AudioDecoder::AudioDecoderPrivate
 {
 public:
-    explicit AudioDecoderPrivate(AudioDecoder *q)
+    explicit AudioDecoderPrivate(AudioDecoder *q, ClockDomain *clockDomain)
         : q_ptr(q)
     {
-        audioDisplay = new AudioDisplay(q_ptr);
+        audioDisplay = new AudioDisplay(clockDomain, q_ptr);
     }
 
-    void processEvent() const
+    [[nodiscard]] auto decodeFrames(const PacketPtr &packetPtr) const -> FramePtrList
     {
-        while (q_ptr->m_runing.load() && !q_ptr->m_eventQueue.isEmpty()) {
-            auto eventPtr = q_ptr->m_eventQueue.take();
-            switch (eventPtr->type()) {
-            case Event::EventType::Pause: audioDisplay->addEvent(eventPtr); break;
-            case Event::EventType::Seek: {
-                auto *seekEvent = static_cast<SeekEvent *>(eventPtr.data());
-                seekEvent->countDown();
-                q_ptr->clear();
-                audioDisplay->addEvent(eventPtr);
-            } break;
-            default: break;
-            }
+        auto framePtrs = q_ptr->m_contextInfo->decodeFrame(packetPtr);
+        for (const auto &framePtr : std::as_const(framePtrs)) {
+            calculatePts(framePtr, q_ptr->m_contextInfo, q_ptr->m_formatContext);
         }
+        return framePtrs;
     }
 
     AudioDecoder *q_ptr;
@@ -40,10 +28,11 @@ public:
     AudioDisplay *audioDisplay;
 };
 
-AudioDecoder::AudioDecoder(QObject *parent)
-    : Decoder<PacketPtr>(parent)
-    , d_ptr(new AudioDecoderPrivate(this))
+AudioDecoder::AudioDecoder(ClockDomain *clockDomain, QObject *parent)
+    : PacketDecoder<FramePtr>(parent)
+    , d_ptr(new AudioDecoderPrivate(this, clockDomain))
 {
+    m_nextStage = d_ptr->audioDisplay;
     connect(d_ptr->audioDisplay,
             &AudioDisplay::positionChanged,
             this,
@@ -65,28 +54,21 @@ void AudioDecoder::setMasterClock()
     d_ptr->audioDisplay->setMasterClock();
 }
 
-void AudioDecoder::runDecoder()
+void AudioDecoder::setMaxBufferDuration(qint64 duration)
 {
-    d_ptr->audioDisplay->startDecoder(m_formatContext, m_contextInfo);
-
-    while (m_runing.load()) {
-        d_ptr->processEvent();
+    PacketDecoder<FramePtr>::setMaxBufferDuration(duration);
+    d_ptr->audioDisplay->setMaxBufferDuration(duration);
+}
 
-        auto packetPtr(m_queue.take());
-        if (nullptr == packetPtr) {
-            continue;
-        }
-        auto framePtrs = m_contextInfo->decodeFrame(packetPtr);
-        for (const auto &framePtr : std::as_const(framePtrs)) {
-            calculatePts(framePtr, m_contextInfo, m_formatContext);
-            d_ptr->audioDisplay->append(framePtr);
-        }
-    }
-    while (m_runing.load() && d_ptr->audioDisplay->size() != 0) {
-        msleep(s_waitQueueEmptyMilliseconds);
-    }
+void AudioDecoder::setMaxBufferBytes(qint64 bytes)
+{
+    PacketDecoder<FramePtr>::setMaxBufferBytes(bytes);
+    d_ptr->audioDisplay->setMaxBufferBytes(bytes);
+}
 
-    d_ptr->audioDisplay->stopDecoder();
+auto AudioDecoder::decodePacket(const PacketPtr &packetPtr) -> FramePtrList
+{
+    return d_ptr->decodeFrames(packetPtr);
 }
 
 } // namespace Ffmpeg
@@ -1,26 +1,32 @@
 #pragma once
 
 #include "decoder.h"
+#include "frame.hpp"
 #include "packet.hpp"
 
 namespace Ffmpeg {
 
-class AudioDecoder : public Decoder<PacketPtr>
+class ClockDomain;
+
+class AudioDecoder : public PacketDecoder<FramePtr>
 {
     Q_OBJECT
 public:
-    explicit AudioDecoder(QObject *parent = nullptr);
+    explicit AudioDecoder(ClockDomain *clockDomain, QObject *parent = nullptr);
     ~AudioDecoder() override;
 
     void setVolume(qreal volume);
 
     void setMasterClock();
 
+    void setMaxBufferDuration(qint64 duration) override; // microsecond
+    void setMaxBufferBytes(qint64 bytes) override;
+
 signals:
     void positionChanged(qint64 position); // ms
 
 protected:
-    void runDecoder() override;
+    auto decodePacket(const PacketPtr &packetPtr) -> FramePtrList override;
 
 private:
     class AudioDecoderPrivate;
@@ -17,10 +17,10 @@ namespace Ffmpeg {
 class AudioDisplay::AudioDisplayPrivate
 {
 public:
-    explicit AudioDisplayPrivate(AudioDisplay *q)
+    explicit AudioDisplayPrivate(AudioDisplay *q, ClockDomain *clockDomain)
         : q_ptr(q)
     {
-        clock = new Clock(q);
+        clock = new Clock(clockDomain, q);
     }
 
     ~AudioDisplayPrivate() = default;
@@ -55,9 +55,9 @@ public:
     QWaitCondition waitCondition;
 };
 
-AudioDisplay::AudioDisplay(QObject *parent)
+AudioDisplay::AudioDisplay(ClockDomain *clockDomain, QObject *parent)
     : Decoder<FramePtr>(parent)
-    , d_ptr(new AudioDisplayPrivate(this))
+    , d_ptr(new AudioDisplayPrivate(this, clockDomain))
 {}
 
 AudioDisplay::~AudioDisplay()
@@ -75,7 +75,7 @@ void AudioDisplay::setVolume(qreal volume)
 
 void AudioDisplay::setMasterClock()
 {
-    Clock::setMaster(d_ptr->clock);
+    d_ptr->clock->domain()->setMaster(d_ptr->clock);
 }
 
 void AudioDisplay::runDecoder()
@@ -90,6 +90,9 @@ void AudioDisplay::runDecoder()
 
         auto framePtr(m_queue.take());
         if (nullptr == framePtr) {
+            if (isEofReached()) {
+                break;
+            }
             continue;
         }
         if (!firstFrame) {
@@ -5,11 +5,13 @@
 
 namespace Ffmpeg {
 
+class ClockDomain;
+
 class AudioDisplay : public Decoder<FramePtr>
 {
     Q_OBJECT
 public:
-    explicit AudioDisplay(QObject *parent = nullptr);
+    explicit AudioDisplay(ClockDomain *clockDomain, QObject *parent = nullptr);
     ~AudioDisplay() override;
 
     void setVolume(qreal volume);
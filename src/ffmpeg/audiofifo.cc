@@ -7,10 +7,14 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/audio_fifo.h>
+#include <libavutil/buffer.h>
 }
 
 namespace Ffmpeg {
 
+// decoders with a variable frame size do not report it
+static constexpr auto s_defaultInputFrameSize = 4096;
+
 class AudioFifo::AudioFifoPrivtate
 {
 public:
@@ -23,32 +27,107 @@ public:
         if (audioFifo != nullptr) {
             av_audio_fifo_free(audioFifo);
         }
+        av_buffer_pool_uninit(&bufferPool);
+        av_channel_layout_uninit(&chLayout);
+    }
+
+    // one buffer per plane, the frames return them to the pool when they are released
+    void initBufferPool()
+    {
+        auto planar = av_sample_fmt_is_planar(sampleFmt) != 0;
+        planes = planar ? chLayout.nb_channels : 1;
+        if (planes > AV_NUM_DATA_POINTERS) {
+            return;
+        }
+        auto size = av_samples_get_buffer_size(&linesize,
+                                               planar ? 1 : chLayout.nb_channels,
+                                               capacity,
+                                               sampleFmt,
+                                               0);
+        if (size <= 0) {
+            return;
+        }
+        bufferPool = av_buffer_pool_init(size, nullptr);
+        poolSamples = capacity;
+    }
+
+    [[nodiscard]] auto createFrame(int nb_samples) const -> FramePtr
+    {
+        auto framePtr = Frame::create();
+        auto *avFrame = framePtr->avFrame();
+        avFrame->nb_samples = nb_samples;
+        av_channel_layout_copy(&avFrame->ch_layout, &chLayout);
+        avFrame->format = sampleFmt;
+        avFrame->sample_rate = sampleRate;
+        if (bufferPool == nullptr || nb_samples > poolSamples) {
+            return framePtr->getBuffer() ? framePtr : nullptr;
+        }
+        for (int i = 0; i < planes; i++) {
+            avFrame->buf[i] = av_buffer_pool_get(bufferPool);
+            if (avFrame->buf[i] == nullptr) {
+                return nullptr;
+            }
+            avFrame->data[i] = avFrame->buf[i]->data;
+        }
+        avFrame->extended_data = avFrame->data;
+        avFrame->linesize[0] = linesize;
+        return framePtr;
     }
 
     AudioFifo *q_ptr;
 
     AVAudioFifo *audioFifo = nullptr;
+    AVSampleFormat sampleFmt = AV_SAMPLE_FMT_NONE;
+    AVChannelLayout chLayout{};
+    int sampleRate = 0;
+    AVRational timebase{};
+    int capacity = 0;
+
+    AVBufferPool *bufferPool = nullptr;
+    int poolSamples = 0;
+    int planes = 0;
+    int linesize = 0;
+
+    qint64 pts = 0; // 1/sample_rate
 };
 
-AudioFifo::AudioFifo(CodecContext *ctx, QObject *parent)
+AudioFifo::AudioFifo(CodecContext *ctx, int inputFrameSize, QObject *parent)
     : QObject{parent}
     , d_ptr(new AudioFifoPrivtate(this))
 {
     auto *avCodecCtx = ctx->avCodecCtx();
-    d_ptr->audioFifo = av_audio_fifo_alloc(avCodecCtx->sample_fmt, ctx->chLayout().nb_channels, 1);
+    d_ptr->sampleFmt = avCodecCtx->sample_fmt;
+    av_channel_layout_copy(&d_ptr->chLayout, &avCodecCtx->ch_layout);
+    d_ptr->sampleRate = avCodecCtx->sample_rate;
+    d_ptr->timebase = avCodecCtx->time_base;
+    d_ptr->capacity = qMax(avCodecCtx->frame_size, 1)
+                      + (inputFrameSize > 0 ? inputFrameSize : s_defaultInputFrameSize);
+    d_ptr->audioFifo = av_audio_fifo_alloc(avCodecCtx->sample_fmt,
+                                           ctx->chLayout().nb_channels,
+                                           d_ptr->capacity);
     Q_ASSERT(nullptr != d_ptr->audioFifo);
+    d_ptr->initBufferPool();
 }
 
 AudioFifo::~AudioFifo() = default;
 
 auto AudioFifo::realloc(int nb_samples) -> bool
 {
+    if (nb_samples <= d_ptr->capacity) {
+        return true;
+    }
     auto ret = av_audio_fifo_realloc(d_ptr->audioFifo, nb_samples);
-    ERROR_RETURN(ret)
+    if (ret < 0) {
+        SET_ERROR_CODE(ret);
+        return false;
+    }
+    d_ptr->capacity = nb_samples;
+    return true;
 }
 
 auto AudioFifo::write(void **data, int nb_samples) -> bool
 {
+    // av_audio_fifo_write() grows on its own, only when the input frames outgrow the capacity
     auto ret = av_audio_fifo_write(d_ptr->audioFifo, data, nb_samples);
     if (ret < nb_samples) {
         qWarning() << "Could not write data to FIFO";
@@ -64,12 +143,51 @@ auto AudioFifo::read(void **data, int nb_samples) -> bool
         qWarning() << "Could not read data from FIFO";
         return false;
     }
+    d_ptr->pts += nb_samples;
     return true;
 }
 
+auto AudioFifo::write(const FramePtr &framePtr) -> bool
+{
+    auto *avFrame = framePtr->avFrame();
+    return write(reinterpret_cast<void **>(avFrame->extended_data), avFrame->nb_samples);
+}
+
+auto AudioFifo::read(int nb_samples) -> FramePtr
+{
+    if (nb_samples <= 0 || size() < nb_samples) {
+        return nullptr;
+    }
+    auto framePtr = d_ptr->createFrame(nb_samples);
+    if (nullptr == framePtr) {
+        return nullptr;
+    }
+    auto *avFrame = framePtr->avFrame();
+    avFrame->pts = av_rescale_q(d_ptr->pts, AVRational{1, d_ptr->sampleRate}, d_ptr->timebase);
+    if (!read(reinterpret_cast<void **>(avFrame->extended_data), nb_samples)) {
+        return nullptr;
+    }
+    return framePtr;
+}
+
+void AudioFifo::setPts(qint64 pts, const AVRational &timebase)
+{
+    d_ptr->pts = av_rescale_q(pts, timebase, AVRational{1, d_ptr->sampleRate});
+}
+
+auto AudioFifo::pts() const -> qint64
+{
+    return d_ptr->pts;
+}
+
 auto AudioFifo::size() const -> int
 {
     return av_audio_fifo_size(d_ptr->audioFifo);
 }
 
+auto AudioFifo::capacity() const -> int
+{
+    return d_ptr->capacity;
+}
+
 } // namespace Ffmpeg
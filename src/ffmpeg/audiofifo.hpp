@@ -1,15 +1,23 @@
 #ifndef AUDIOFIFO_HPP
 #define AUDIOFIFO_HPP
 
+#include "frame.hpp"
+
 #include <QObject>
 
+extern "C" {
+#include <libavutil/rational.h>
+}
+
 namespace Ffmpeg {
 
 class CodecContext;
 class AudioFifo : public QObject
 {
 public:
-    explicit AudioFifo(CodecContext *ctx, QObject *parent = nullptr);
+    // Ring buffer in the sample format of the encoder ctx, sized once for one encoder frame plus
+    // one input frame; inputFrameSize <= 0 takes a default
+    explicit AudioFifo(CodecContext *ctx, int inputFrameSize = 0, QObject *parent = nullptr);
     ~AudioFifo() override;
 
     auto realloc(int nb_samples) -> bool;
@@ -17,7 +25,16 @@ public:
     auto write(void **data, int nb_samples) -> bool;
     auto read(void **data, int nb_samples) -> bool;
 
+    auto write(const FramePtr &framePtr) -> bool;
+    // nb_samples in a frame from a buffer pool, its pts in the time base of the encoder ctx
+    auto read(int nb_samples) -> FramePtr;
+
+    // Sample-accurate timestamps, the pts of the next sample read
+    void setPts(qint64 pts, const AVRational &timebase);
+    [[nodiscard]] auto pts() const -> qint64; // 1/sample_rate
+
     [[nodiscard]] auto size() const -> int;
+    [[nodiscard]] auto capacity() const -> int;
 
 private:
     class AudioFifoPrivtate;
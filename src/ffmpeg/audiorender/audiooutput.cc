@@ -2,6 +2,7 @@
 
 #include <ffmpeg/audioframeconverter.h>
 #include <ffmpeg/avcontextinfo.h>
+#include <ffmpeg/memorybudget.hpp>
 #include <utils/concurrentqueue.hpp>
 
 #include <QApplication>
@@ -67,6 +68,7 @@ public:
     QMediaDevices *mediaDevices;
     QAudioDevice audioDevice;
     QByteArray audioBuf;
+    MemoryReservation audioBufReservation;
 };
 
 AudioOutput::AudioOutput(AVContextInfo *contextInfo, qreal volume, QObject *parent)
@@ -89,6 +91,7 @@ void AudioOutput::onConvertData(const FramePtr &framePtr)
 
     auto audioBuf = d_ptr->audioConverterPtr->convert(framePtr);
     d_ptr->audioBuf += audioBuf;
+    d_ptr->audioBufReservation.setBytes(d_ptr->audioBuf.size());
 }
 
 void AudioOutput::onWrite()
@@ -107,6 +110,7 @@ void AudioOutput::onWrite()
             break;
         }
     }
+    d_ptr->audioBufReservation.setBytes(d_ptr->audioBuf.size());
 }
 
 void AudioOutput::onSetVolume(qreal value)
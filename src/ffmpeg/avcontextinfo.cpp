@@ -5,6 +5,7 @@
 #include <gpu/hardwareencode.hpp>
 
 #include <QDebug>
+#include <QThread>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -23,14 +24,88 @@ public:
         : q_ptr(q)
     {}
 
+    // threads worth spending on one decoder, more do not pay off for small pictures
+    [[nodiscard]] auto autoThreadCount() const -> int
+    {
+        auto *codecpar = stream->codecpar;
+        if (codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+            return 1;
+        }
+        auto pixels = static_cast<qint64>(codecpar->width) * codecpar->height;
+        int threads = 16;
+        if (pixels <= 640 * 480) {
+            threads = 2;
+        } else if (pixels <= 1280 * 720) {
+            threads = 4;
+        } else if (pixels <= 1920 * 1080) {
+            threads = 8;
+        }
+        return qBound(1, threads, QThread::idealThreadCount());
+    }
+
+    [[nodiscard]] auto chooseThreadConfig(const AVCodec *codec) const -> DecodeThreadConfig
+    {
+        if (threadMode == ManualThread) {
+            return manualThreadConfig;
+        }
+        DecodeThreadConfig config;
+        config.threadCount = autoThreadCount();
+        if (config.threadCount <= 1) {
+            return config;
+        }
+        config.sliceThreads = (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) != 0;
+        config.frameThreads = threadMode == AutoThread
+                              && (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) != 0;
+        if (!config.sliceThreads && !config.frameThreads) {
+            config.threadCount = 1;
+        }
+        return config;
+    }
+
+    void applyThreadConfig(const DecodeThreadConfig &config)
+    {
+        threadConfig = config;
+        codecCtx->setThreadCount(config.threadCount);
+        codecCtx->setThreadType((config.frameThreads ? FF_THREAD_FRAME : 0)
+                                | (config.sliceThreads ? FF_THREAD_SLICE : 0));
+    }
+
+    void applyThumbnailConfig()
+    {
+        codecCtx->setSkipFrame(AVDISCARD_NONKEY);
+        codecCtx->setSkipLoopFilter(AVDISCARD_ALL);
+        if (threadMode != ManualThread) {
+            applyThreadConfig({});
+        }
+        // the hwaccels decode at full size
+        if (gpuType == GpuDecode || !thumbnailSize.isValid()) {
+            return;
+        }
+        auto *avCodecCtx = codecCtx->avCodecCtx();
+        QSize size(avCodecCtx->width, avCodecCtx->height);
+        auto dstSize = size.scaled(thumbnailSize, Qt::KeepAspectRatio);
+        int lowres = 0;
+        while (lowres < codecCtx->maxLowres() && (size.width() >> (lowres + 1)) >= dstSize.width()
+               && (size.height() >> (lowres + 1)) >= dstSize.height()) {
+            ++lowres;
+        }
+        codecCtx->setLowres(lowres);
+    }
+
     AVContextInfo *q_ptr;
 
+    DecodeThreadMode threadMode = AutoThread;
+    DecodeThreadConfig manualThreadConfig;
+    DecodeThreadConfig threadConfig; // chosen or active
+
     QScopedPointer<CodecContext> codecCtx; //解码器上下文
     AVStream *stream = nullptr;            //流
     int streamIndex = INVALID_INDEX;       // 索引
     QScopedPointer<HardWareDecode> hardWareDecodePtr;
     QScopedPointer<HardWareEncode> hardWareEncodePtr;
     GpuType gpuType = GpuType::NotUseGpu;
+    bool thumbnailDecode = false;
+    QSize thumbnailSize;
 };
 
 AVContextInfo::AVContextInfo(QObject *parent)
@@ -75,6 +150,37 @@ auto AVContextInfo::stream() -> AVStream *
     return d_ptr->stream;
 }
 
+void AVContextInfo::setDecodeThreadMode(DecodeThreadMode mode)
+{
+    d_ptr->threadMode = mode;
+}
+
+auto AVContextInfo::decodeThreadMode() const -> DecodeThreadMode
+{
+    return d_ptr->threadMode;
+}
+
+void AVContextInfo::setDecodeThreadConfig(const DecodeThreadConfig &config)
+{
+    d_ptr->manualThreadConfig = config;
+}
+
+auto AVContextInfo::decodeThreadConfig() const -> DecodeThreadConfig
+{
+    return d_ptr->threadConfig;
+}
+
+void AVContextInfo::setThumbnailDecode(bool enable, const QSize &size)
+{
+    d_ptr->thumbnailDecode = enable;
+    d_ptr->thumbnailSize = size;
+}
+
+auto AVContextInfo::isThumbnailDecode() const -> bool
+{
+    return d_ptr->thumbnailDecode;
+}
+
 auto AVContextInfo::initDecoder(const AVRational &frameRate) -> bool
 {
     Q_ASSERT(d_ptr->stream != nullptr);
@@ -90,7 +196,7 @@ auto AVContextInfo::initDecoder(const AVRational &frameRate) -> bool
     }
     auto *avCodecCtx = d_ptr->codecCtx->avCodecCtx();
     avCodecCtx->pkt_timebase = d_ptr->stream->time_base;
-    d_ptr->codecCtx->setThreadCount(4);
+    d_ptr->applyThreadConfig(d_ptr->chooseThreadConfig(codec));
     if (d_ptr->stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         avCodecCtx->framerate = frameRate;
     }
@@ -126,6 +232,10 @@ auto AVContextInfo::openCodec(GpuType type) -> bool
     if (mediaType() == AVMEDIA_TYPE_VIDEO) {
         switch (d_ptr->gpuType) {
         case GpuDecode:
+            // the device decodes, cpu threads would only add latency
+            if (d_ptr->threadMode != ManualThread && isDecoder()) {
+                d_ptr->applyThreadConfig({});
+            }
             d_ptr->hardWareDecodePtr.reset(new HardWareDecode);
             d_ptr->hardWareDecodePtr->initPixelFormat(d_ptr->codecCtx->avCodecCtx()->codec);
             d_ptr->hardWareDecodePtr->initHardWareDevice(d_ptr->codecCtx.data());
@@ -137,12 +247,24 @@ auto AVContextInfo::openCodec(GpuType type) -> bool
             break;
         default: break;
         }
+        if (d_ptr->thumbnailDecode && isDecoder()) {
+            d_ptr->applyThumbnailConfig();
+        }
     }
 
     //用于初始化pCodecCtx结构
     if (!d_ptr->codecCtx->open()) {
         return false;
     }
+    if (isDecoder()) {
+        auto activeType = d_ptr->codecCtx->activeThreadType();
+        d_ptr->threadConfig.threadCount = d_ptr->codecCtx->threadCount();
+        d_ptr->threadConfig.frameThreads = (activeType & FF_THREAD_FRAME) != 0;
+        d_ptr->threadConfig.sliceThreads = (activeType & FF_THREAD_SLICE) != 0;
+        qInfo() << mediaTypeString() << "decode threads:" << d_ptr->threadConfig.threadCount
+                << "frame:" << d_ptr->threadConfig.frameThreads
+                << "slice:" << d_ptr->threadConfig.sliceThreads;
+    }
     return true;
 }
 
@@ -158,7 +280,7 @@ auto AVContextInfo::decodeFrame(const PacketPtr &packetPtr) -> FramePtrList
     if (!d_ptr->codecCtx->sendPacket(packetPtr)) {
         return framePtrs;
     }
-    FramePtr framePtr(new Frame);
+    auto framePtr = Frame::create();
     while (d_ptr->codecCtx->receiveFrame(framePtr)) {
         framePtr->avFrame()->time_base = stream()->time_base;
         if (d_ptr->gpuType == GpuDecode && mediaType() == AVMEDIA_TYPE_VIDEO) {
@@ -168,8 +290,9 @@ auto AVContextInfo::decodeFrame(const PacketPtr &packetPtr) -> FramePtrList
                 return framePtrs;
             }
         }
+        framePtr->trackMemory();
         framePtrs.push_back(framePtr);
-        framePtr.reset(new Frame);
+        framePtr = Frame::create();
     }
     return framePtrs;
 }
@@ -189,10 +312,10 @@ auto AVContextInfo::encodeFrame(const FramePtr &framePtr) -> PacketPtrList
     if (!d_ptr->codecCtx->sendFrame(frame_tmp_ptr)) {
         return packetPtrs;
     }
-    PacketPtr packetPtr(new Packet);
+    auto packetPtr = Packet::create();
     while (d_ptr->codecCtx->receivePacket(packetPtr)) {
         packetPtrs.push_back(packetPtr);
-        packetPtr.reset(new Packet);
+        packetPtr = Packet::create();
     }
     return packetPtrs;
 }
@@ -22,6 +22,16 @@ class FFMPEG_EXPORT AVContextInfo : public QObject
 public:
     enum GpuType { NotUseGpu, GpuDecode, GpuEncode };
 
+    // Auto: by codec, resolution and core count; LowLatency: no frame threading, it delays
+    // output by one frame per thread; Manual: as set by setDecodeThreadConfig
+    enum DecodeThreadMode { AutoThread, LowLatencyThread, ManualThread };
+    struct DecodeThreadConfig
+    {
+        int threadCount = 1; // 0 lets FFmpeg decide
+        bool frameThreads = false;
+        bool sliceThreads = false;
+    };
+
     explicit AVContextInfo(QObject *parent = nullptr);
     ~AVContextInfo() override;
 
@@ -34,6 +44,18 @@ public:
     void setStream(AVStream *stream);
     auto stream() -> AVStream *;
 
+    // Set before initDecoder
+    void setDecodeThreadMode(DecodeThreadMode mode);
+    [[nodiscard]] auto decodeThreadMode() const -> DecodeThreadMode;
+    void setDecodeThreadConfig(const DecodeThreadConfig &config);
+    // chosen by initDecoder, after openCodec what the codec actually uses
+    [[nodiscard]] auto decodeThreadConfig() const -> DecodeThreadConfig;
+
+    // Set before openCodec, for thumbnails: key frames only, no loop filter, one thread and with
+    // the software decoder the lowest resolution (lowres) that still covers size
+    void setThumbnailDecode(bool enable, const QSize &size = {});
+    [[nodiscard]] auto isThumbnailDecode() const -> bool;
+
     auto initDecoder(const AVRational &frameRate) -> bool;
     auto initEncoder(AVCodecID codecId) -> bool;
     auto initEncoder(const QString &name) -> bool;
@@ -9,146 +9,261 @@ extern "C" {
 
 namespace Ffmpeg {
 
-class Clock::ClockPrivate
+class ClockDomain::ClockDomainPrivate
 {
 public:
-    explicit ClockPrivate(Clock *q)
+    explicit ClockDomainPrivate(ClockDomain *q)
         : q_ptr(q)
     {}
 
+    ClockDomain *q_ptr;
+
+    std::atomic<qint64> serial = 0; // 时钟序列号 for seek
+    std::atomic<double> speed = 1.0;
+    std::atomic<Clock *> master = nullptr;
+};
+
+ClockDomain::ClockDomain(QObject *parent)
+    : QObject{parent}
+    , d_ptr(new ClockDomainPrivate(this))
+{}
+
+ClockDomain::~ClockDomain() = default;
+
+void ClockDomain::serialRef()
+{
+    d_ptr->serial.fetch_add(1);
+}
+
+void ClockDomain::serialReset()
+{
+    d_ptr->serial.store(0);
+}
+
+auto ClockDomain::serial() const -> qint64
+{
+    return d_ptr->serial.load();
+}
+
+void ClockDomain::setSpeed(double value)
+{
+    d_ptr->speed.store(value);
+}
+
+auto ClockDomain::speed() const -> double
+{
+    return d_ptr->speed.load();
+}
+
+void ClockDomain::setMaster(Clock *clock)
+{
+    d_ptr->master.store(clock);
+}
+
+auto ClockDomain::master() const -> Clock *
+{
+    return d_ptr->master.load();
+}
+
+class Clock::ClockPrivate
+{
+public:
+    struct State
+    {
+        qint64 pts = 0;          // 当前 AVFrame 的时间戳 microseconds
+        qint64 pts_drift = 0;    // 时钟漂移量，用于计算当前时钟的状态 microseconds
+        qint64 last_updated = 0; // 上一次更新时钟状态的时间 microseconds
+        qint64 serial = 0;       // 时钟序列号 for seek
+        bool paused = false;     // 是否暂停播放
+    };
+
+    explicit ClockPrivate(Clock *q, ClockDomain *clockDomain)
+        : q_ptr(q)
+        , domain(clockDomain)
+    {
+        serial.store(domain->serial(), std::memory_order_relaxed);
+    }
+
+    // seqlock read, never blocks the writer; retries while a write is in progress
+    [[nodiscard]] auto load() const -> State
+    {
+        State state;
+        quint64 begin = 0;
+        do {
+            begin = sequence.load(std::memory_order_acquire);
+            if ((begin & 1) != 0) {
+                continue;
+            }
+            state.pts = pts.load(std::memory_order_relaxed);
+            state.pts_drift = pts_drift.load(std::memory_order_relaxed);
+            state.last_updated = last_updated.load(std::memory_order_relaxed);
+            state.serial = serial.load(std::memory_order_relaxed);
+            state.paused = paused.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((begin & 1) != 0 || sequence.load(std::memory_order_relaxed) != begin);
+        return state;
+    }
+
+    // writers are serialized among themselves only
+    template<typename Func>
+    void modify(Func func)
+    {
+        QMutexLocker locker(&writeMutex);
+        State state{pts.load(std::memory_order_relaxed),
+                    pts_drift.load(std::memory_order_relaxed),
+                    last_updated.load(std::memory_order_relaxed),
+                    serial.load(std::memory_order_relaxed),
+                    paused.load(std::memory_order_relaxed)};
+        func(state);
+
+        sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        pts.store(state.pts, std::memory_order_relaxed);
+        pts_drift.store(state.pts_drift, std::memory_order_relaxed);
+        last_updated.store(state.last_updated, std::memory_order_relaxed);
+        serial.store(state.serial, std::memory_order_relaxed);
+        paused.store(state.paused, std::memory_order_relaxed);
+        sequence.fetch_add(1, std::memory_order_release);
+    }
+
     Clock *q_ptr;
+    ClockDomain *domain;
 
-    mutable QMutex mutex;
-    qint64 pts = 0;          // 当前 AVFrame 的时间戳 microseconds
-    qint64 pts_drift = 0;    // 时钟漂移量，用于计算当前时钟的状态 microseconds
-    qint64 last_updated = 0; // 上一次更新时钟状态的时间 microseconds
-    qint64 serial = s_serial.load(); // 时钟序列号 for seek
-    bool paused = false;             // 是否暂停播放
+    QMutex writeMutex;
+    std::atomic<quint64> sequence = 0; // odd while a write is in progress
+    std::atomic<qint64> pts = 0;
+    std::atomic<qint64> pts_drift = 0;
+    std::atomic<qint64> last_updated = 0;
+    std::atomic<qint64> serial = 0;
+    std::atomic_bool paused = false;
 
-    static std::atomic<qint64> s_serial;
-    static std::atomic<double> s_speed;
     static constexpr auto s_diffThreshold = 100 * 1000; // 100 milliseconds
     // static constexpr auto s_diffThreshold = 200 * 1000; // 200 milliseconds
-    static Clock *s_clock;
 };
 
-std::atomic<qint64> Clock::ClockPrivate::s_serial = 0;
-std::atomic<double> Clock::ClockPrivate::s_speed = 1.0;
-Clock *Clock::ClockPrivate::s_clock = nullptr;
-
-Clock::Clock(QObject *parent)
+Clock::Clock(ClockDomain *domain, QObject *parent)
     : QObject{parent}
-    , d_ptr(new ClockPrivate(this))
-{}
+    , d_ptr(new ClockPrivate(this, domain))
+{
+    Q_ASSERT(domain != nullptr);
+}
 
 Clock::~Clock() = default;
 
+auto Clock::domain() const -> ClockDomain *
+{
+    return d_ptr->domain;
+}
+
 void Clock::reset(qint64 pts)
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    d_ptr->pts = pts;
-    d_ptr->pts_drift = 0;
-    d_ptr->last_updated = av_gettime_relative();
-    d_ptr->serial = Clock::ClockPrivate::s_serial.load();
-    d_ptr->paused = false;
+    auto serial = d_ptr->domain->serial();
+    d_ptr->modify([&](ClockPrivate::State &state) {
+        state.pts = pts;
+        state.pts_drift = 0;
+        state.last_updated = av_gettime_relative();
+        state.serial = serial;
+        state.paused = false;
+    });
 }
 
 void Clock::invalidate()
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    d_ptr->last_updated = 0;
+    d_ptr->modify([](ClockPrivate::State &state) { state.last_updated = 0; });
 }
 
 auto Clock::isVaild() const -> bool
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    return d_ptr->last_updated != 0;
+    return d_ptr->last_updated.load(std::memory_order_acquire) != 0;
 }
 
 auto Clock::pts() const -> qint64
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    return d_ptr->pts;
+    return d_ptr->pts.load(std::memory_order_acquire);
 }
 
 auto Clock::ptsDrift() const -> qint64
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    return d_ptr->pts_drift;
+    return d_ptr->pts_drift.load(std::memory_order_acquire);
 }
 
 auto Clock::lastUpdated() const -> qint64
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    return d_ptr->last_updated;
+    return d_ptr->last_updated.load(std::memory_order_acquire);
 }
 
 void Clock::resetSerial()
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    d_ptr->serial = Clock::ClockPrivate::s_serial.load();
+    auto serial = d_ptr->domain->serial();
+    d_ptr->modify([serial](ClockPrivate::State &state) { state.serial = serial; });
 }
 
 auto Clock::serial() const -> qint64
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    return d_ptr->serial;
+    return d_ptr->serial.load(std::memory_order_acquire);
 }
 
 auto Clock::paused() const -> bool
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    return d_ptr->paused;
+    return d_ptr->paused.load(std::memory_order_acquire);
 }
 
 void Clock::setPaused(bool value)
 {
-    QMutexLocker locker(&d_ptr->mutex);
-    d_ptr->paused = value;
-    if (!d_ptr->paused) {
-        d_ptr->last_updated = 0;
-        d_ptr->pts_drift = 0;
-    }
+    d_ptr->modify([value](ClockPrivate::State &state) {
+        state.paused = value;
+        if (!state.paused) {
+            state.last_updated = 0;
+            state.pts_drift = 0;
+        }
+    });
 }
 
 void Clock::update(qint64 pts, qint64 time)
 {
-    Q_ASSERT(Clock::ClockPrivate::s_clock);
-
-    QMutexLocker locker(&d_ptr->mutex);
-    if ((d_ptr->last_updated != 0) && !d_ptr->paused) {
-        if (this == Clock::ClockPrivate::s_clock
-            || Clock::ClockPrivate::s_clock->d_ptr->last_updated == 0) {
-            qint64 timediff = (time - d_ptr->last_updated) * speed();
-            d_ptr->pts_drift += pts - d_ptr->pts - timediff;
-        } else {
-            auto *masterClock = Clock::ClockPrivate::s_clock;
-            auto masterClockPts = masterClock->d_ptr->pts - masterClock->d_ptr->pts_drift;
-            qint64 timediff = (time - masterClock->d_ptr->last_updated) * speed();
-            d_ptr->pts_drift = pts - masterClockPts - timediff;
-        }
+    auto *masterClock = d_ptr->domain->master();
+    Q_ASSERT(masterClock);
+
+    auto speed = d_ptr->domain->speed();
+    // consistent snapshot of the master, taken before our own write lock
+    ClockPrivate::State master;
+    if (this != masterClock) {
+        master = masterClock->d_ptr->load();
     }
-    d_ptr->pts = pts;
-    d_ptr->last_updated = time;
+    d_ptr->modify([&](ClockPrivate::State &state) {
+        if ((state.last_updated != 0) && !state.paused) {
+            if (this == masterClock || master.last_updated == 0) {
+                qint64 timediff = (time - state.last_updated) * speed;
+                state.pts_drift += pts - state.pts - timediff;
+            } else {
+                auto masterClockPts = master.pts - master.pts_drift;
+                qint64 timediff = (time - master.last_updated) * speed;
+                state.pts_drift = pts - masterClockPts - timediff;
+            }
+        }
+        state.pts = pts;
+        state.last_updated = time;
+    });
 }
 
 auto Clock::getDelayWithMaster(qint64 &delay) const -> bool
 {
-    if (serial() != Clock::ClockPrivate::s_serial.load()) {
+    auto state = d_ptr->load();
+    if (state.serial != d_ptr->domain->serial()) {
         return false;
     }
-    delay = ptsDrift();
+    delay = state.pts_drift;
     return true;
 }
 
 auto Clock::adjustDelay(qint64 &delay) -> bool
 {
-    if (speed() > 1.0 && delay < 0) {
+    if (d_ptr->domain->speed() > 1.0 && delay < 0) {
         return false;
     }
     if (delay < -Clock::ClockPrivate::s_diffThreshold) {
         reset(pts()); // 有可能是因为网络下载过慢导致的延迟，需要重置
-        if (this == Clock::ClockPrivate::s_clock) { // 主时钟不丢帧
+        if (this == d_ptr->domain->master()) { // 主时钟不丢帧
             delay = 0;
             return true;
         }
@@ -162,34 +277,4 @@ auto Clock::adjustDelay(qint64 &delay) -> bool
     return true;
 }
 
-void Clock::globalSerialRef()
-{
-    Clock::ClockPrivate::s_serial.fetch_add(1);
-}
-
-void Clock::globalSerialReset()
-{
-    Clock::ClockPrivate::s_serial.store(0);
-}
-
-void Clock::setSpeed(double value)
-{
-    Clock::ClockPrivate::s_speed.store(value);
-}
-
-auto Clock::speed() -> double
-{
-    return Clock::ClockPrivate::s_speed.load();
-}
-
-void Clock::setMaster(Clock *clock)
-{
-    Clock::ClockPrivate::s_clock = clock;
-}
-
-auto Clock::master() -> Clock *
-{
-    return Clock::ClockPrivate::s_clock;
-}
-
 } // namespace Ffmpeg
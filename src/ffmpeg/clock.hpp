@@ -5,12 +5,39 @@
 
 namespace Ffmpeg {
 
+class Clock;
+
+// Timing state shared by the clocks of one player: master clock, seek serial and speed.
+class ClockDomain : public QObject
+{
+public:
+    explicit ClockDomain(QObject *parent = nullptr);
+    ~ClockDomain() override;
+
+    void serialRef();
+    void serialReset();
+    [[nodiscard]] auto serial() const -> qint64;
+
+    void setSpeed(double value);
+    [[nodiscard]] auto speed() const -> double;
+
+    // not delete clock
+    void setMaster(Clock *clock);
+    [[nodiscard]] auto master() const -> Clock *;
+
+private:
+    class ClockDomainPrivate;
+    QScopedPointer<ClockDomainPrivate> d_ptr;
+};
+
 class Clock : public QObject
 {
 public:
-    explicit Clock(QObject *parent = nullptr);
+    explicit Clock(ClockDomain *domain, QObject *parent = nullptr);
     ~Clock() override;
 
+    [[nodiscard]] auto domain() const -> ClockDomain *;
+
     void reset(qint64 pts);
 
     void invalidate();
@@ -34,16 +61,6 @@ public:
     // return true if delay is valid
     auto adjustDelay(qint64 &delay) -> bool;
 
-    static void globalSerialRef();
-    static void globalSerialReset();
-
-    static void setSpeed(double value);
-    static auto speed() -> double;
-
-    // not thread safe and not delete clock
-    static void setMaster(Clock *clock);
-    static auto master() -> Clock *;
-
 private:
     class ClockPrivate;
     QScopedPointer<ClockPrivate> d_ptr;
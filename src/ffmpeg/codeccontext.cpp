@@ -350,6 +350,45 @@ void CodecContext::setThreadCount(int threadCount)
     d_ptr->codecCtx->thread_count = threadCount;
 }
 
+void CodecContext::setThreadType(int threadType)
+{
+    Q_ASSERT(d_ptr->codecCtx != nullptr);
+    d_ptr->codecCtx->thread_type = threadType;
+}
+
+void CodecContext::setLowres(int lowres)
+{
+    Q_ASSERT(d_ptr->codecCtx != nullptr);
+    d_ptr->codecCtx->lowres = qBound(0, lowres, maxLowres());
+}
+
+auto CodecContext::maxLowres() const -> int
+{
+    return d_ptr->codecCtx->codec->max_lowres;
+}
+
+auto CodecContext::threadCount() const -> int
+{
+    return d_ptr->codecCtx->thread_count;
+}
+
+auto CodecContext::activeThreadType() const -> int
+{
+    return d_ptr->codecCtx->active_thread_type;
+}
+
+void CodecContext::setSkipFrame(AVDiscard discard)
+{
+    Q_ASSERT(d_ptr->codecCtx != nullptr);
+    d_ptr->codecCtx->skip_frame = discard;
+}
+
+void CodecContext::setSkipLoopFilter(AVDiscard discard)
+{
+    Q_ASSERT(d_ptr->codecCtx != nullptr);
+    d_ptr->codecCtx->skip_loop_filter = discard;
+}
+
 void CodecContext::setPixfmt(AVPixelFormat pixfmt)
 {
     if (d_ptr->supported_pix_fmts.isEmpty() || d_ptr->supported_pix_fmts.contains(pixfmt)) {
@@ -517,7 +556,8 @@ auto CodecContext::receiveFrame(const FramePtr &framePtr) -> bool
         avFrame->ch_layout = d_ptr->codecCtx->ch_layout;
         return true;
     }
-    if (ret != AVERROR(EAGAIN)) { // Resource temporarily unavailable
+    // Resource temporarily unavailable, or fully drained after a flush packet
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
         SET_ERROR_CODE(ret);
     }
     return false;
@@ -8,6 +8,7 @@
 
 extern "C" {
 #include <libavcodec/codec.h>
+#include <libavcodec/defs.h>
 }
 
 struct AVCodecParameters;
@@ -55,8 +56,19 @@ public:
 
     // Set before open, Soft solution is effective
     void setThreadCount(int threadCount);
+    void setThreadType(int threadType); // FF_THREAD_FRAME | FF_THREAD_SLICE, after setThreadCount
+    // Set before open, decodes at 1/2^lowres of the size; clamped to maxLowres()
+    void setLowres(int lowres);
+    [[nodiscard]] auto maxLowres() const -> int; // 0 if the decoder has no lowres
+    // after open, what the codec actually uses
+    [[nodiscard]] auto threadCount() const -> int;
+    [[nodiscard]] auto activeThreadType() const -> int;
     auto open() -> bool;
 
+    // Decoder, may change between packets
+    void setSkipFrame(AVDiscard discard);
+    void setSkipLoopFilter(AVDiscard discard);
+
     auto sendPacket(const PacketPtr &packetPtr) -> bool;
     auto receiveFrame(const FramePtr &framePtr) -> bool;
     auto decodeSubtitle2(Subtitle *subtitle, const PacketPtr &packetPtr) -> bool;
@@ -1 +1,50 @@
 #include "decoder.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace Ffmpeg {
+
+auto queueItemCost(const PacketPtr &packetPtr, AVContextInfo *contextInfo) -> QueueItemCost
+{
+    QueueItemCost cost;
+    if (nullptr == packetPtr) {
+        return cost;
+    }
+    auto *avPacket = packetPtr->avPacket();
+    cost.bytes = packetPtr->bufferSize();
+    if (avPacket->duration > 0) {
+        cost.duration = av_rescale_q(avPacket->duration, contextInfo->timebase(), AV_TIME_BASE_Q);
+    } else if (contextInfo->mediaType() == AVMEDIA_TYPE_VIDEO && contextInfo->fps() > 0) {
+        cost.duration = static_cast<qint64>(AV_TIME_BASE / contextInfo->fps());
+    }
+    return cost;
+}
+
+auto queueItemCost(const FramePtr &framePtr, AVContextInfo *contextInfo) -> QueueItemCost
+{
+    Q_UNUSED(contextInfo)
+    QueueItemCost cost;
+    if (nullptr == framePtr) {
+        return cost;
+    }
+    auto *avFrame = framePtr->avFrame();
+    cost.bytes = framePtr->bufferSize();
+    if (avFrame->nb_samples > 0 && avFrame->sample_rate > 0) {
+        cost.duration = av_rescale(avFrame->nb_samples, AV_TIME_BASE, avFrame->sample_rate);
+    } else {
+        cost.duration = qMax<qint64>(0, framePtr->duration()); // set by calculatePts
+    }
+    return cost;
+}
+
+auto queueItemCost(const QSharedPointer<Subtitle> &subtitlePtr, AVContextInfo *contextInfo)
+    -> QueueItemCost
+{
+    Q_UNUSED(subtitlePtr)
+    Q_UNUSED(contextInfo)
+    return {};
+}
+
+} // namespace Ffmpeg
@@ -4,30 +4,59 @@
 #include <QThread>
 
 #include <event/event.hpp>
+#include <event/seekevent.hpp>
 #include <utils/concurrentqueue.hpp>
+#include <utils/spscqueue.hpp>
 
 #include "avcontextinfo.h"
+#include "decoderscheduler.hpp"
 #include "formatcontext.h"
+#include "packet.hpp"
+
+#include <deque>
 
 extern "C" {
 #include <libavformat/avformat.h>
+#include <libavutil/time.h>
 }
 
 namespace Ffmpeg {
 
 static constexpr auto s_waitQueueEmptyMilliseconds = 50;
-static constexpr auto s_videoQueueSize = 10;
-// For truehd audio, the queue size should be large enough
-static constexpr auto s_audioQueueSize = 200;
+// Only a hard cap, queues are bounded by the buffered duration and bytes below
+static constexpr auto s_maxQueueSize = 4096;
+// Subtitles carry no useful duration for buffering, bound them by count
+static constexpr auto s_subtitleQueueSize = 10;
+// Decoded video frames may hold hardware surfaces from a fixed size pool
+static constexpr auto s_videoFrameQueueSize = 10;
+static constexpr qint64 s_maxBufferDuration = AV_TIME_BASE; // microsecond
+static constexpr qint64 s_maxBufferBytes = 64 * 1024 * 1024; // bytes
+// pooled mode, retry interval while the next stage is full or draining
+static constexpr qint64 s_pooledRetryMicroseconds = 10 * 1000;
+
+
+struct QueueItemCost
+{
+    qint64 duration = 0; // microsecond
+    qint64 bytes = 0;
+};
+
+auto queueItemCost(const PacketPtr &packetPtr, AVContextInfo *contextInfo) -> QueueItemCost;
+auto queueItemCost(const FramePtr &framePtr, AVContextInfo *contextInfo) -> QueueItemCost;
+auto queueItemCost(const QSharedPointer<Subtitle> &subtitlePtr, AVContextInfo *contextInfo)
+    -> QueueItemCost;
 
 template<typename T>
-class Decoder : public QThread
+class Decoder : public QThread, public DecoderTask
 {
 public:
     explicit Decoder(QObject *parent = nullptr)
         : QThread(parent)
-        , m_queue(s_videoQueueSize)
-    {}
+        , m_queue(s_maxQueueSize)
+    {
+        m_queue.setMaxDuration(s_maxBufferDuration);
+        m_queue.setMaxBytes(s_maxBufferBytes);
+    }
     ~Decoder() override = default;
 
     void startDecoder(FormatContext *formatContext, AVContextInfo *contextInfo)
@@ -36,51 +65,118 @@ public:
         m_formatContext = formatContext;
         m_contextInfo = contextInfo;
         m_runing = true;
+        m_eof = false;
         if (!m_contextInfo->isIndexVaild()) {
             return;
         }
-        if (m_contextInfo->stream()->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            m_queue.setMaxSize(s_audioQueueSize);
+        m_drained = false;
+        switch (m_contextInfo->stream()->codecpar->codec_type) {
+        case AVMEDIA_TYPE_SUBTITLE: m_queue.setMaxSize(s_subtitleQueueSize); break;
+        case AVMEDIA_TYPE_VIDEO:
+            m_queue.setMaxSize(std::is_same_v<T, FramePtr> ? s_videoFrameQueueSize
+                                                           : s_maxQueueSize);
+            break;
+        default: m_queue.setMaxSize(s_maxQueueSize); break;
+        }
+        m_queue.start();
+        if (m_pooled) {
+            m_scheduled = true;
+            startPooled();
+            DecoderScheduler::instance()->add(this);
         } else {
-            m_queue.setMaxSize(s_videoQueueSize);
+            start();
         }
-        start();
     }
 
     virtual void stopDecoder()
     {
         m_runing = false;
-        clear();
-        wakeup();
+        cancelDrain();
+        m_queue.abort();
+        if (m_scheduled) {
+            DecoderScheduler::instance()->remove(this);
+            m_scheduled = false;
+            stopPooled();
+        }
         if (isRunning()) {
             quit();
             wait();
         }
+        clear();
         m_eventQueue.clear();
     }
 
+    // from the next start, run as slices on the shared DecoderScheduler instead of an own thread;
+    // only the PacketDecoder stages support it, the display stages keep their own threads
+    void setPooled(bool pooled) { m_pooled = pooled; }
+    [[nodiscard]] auto isPooled() const -> bool { return m_pooled.load(); }
+
+    auto runSlice(qint64 deadline, qint64 &waitUntil) -> SliceResult override
+    {
+        Q_UNUSED(deadline)
+        Q_UNUSED(waitUntil)
+        return SliceResult::Finished;
+    }
+
+    // 0 means unlimited
+    virtual void setMaxBufferDuration(qint64 duration) { m_queue.setMaxDuration(duration); }
+    [[nodiscard]] auto maxBufferDuration() const -> qint64 { return m_queue.maxDuration(); }
+    virtual void setMaxBufferBytes(qint64 bytes) { m_queue.setMaxBytes(bytes); }
+    [[nodiscard]] auto maxBufferBytes() const -> qint64 { return m_queue.maxBytes(); }
+
+    [[nodiscard]] auto bufferDuration() const -> qint64 { return m_queue.duration(); }
+    [[nodiscard]] auto bufferBytes() const -> qint64 { return m_queue.bytes(); }
+
+    // producer thread, append() would block
+    [[nodiscard]] auto isFull() const -> bool { return m_queue.isFull(); }
+
     void append(const T &t)
     {
         assertVaild();
-        m_queue.push_back(t);
+        auto cost = queueItemCost(t, m_contextInfo);
+        m_queue.push_back(t, cost.duration, cost.bytes);
+        wakeScheduled();
     }
     void append(T &&t)
     {
         assertVaild();
-        m_queue.append(t);
+        auto cost = queueItemCost(t, m_contextInfo);
+        m_queue.push_back(std::move(t), cost.duration, cost.bytes);
+        wakeScheduled();
     }
 
     auto size() -> size_t { return m_queue.size(); }
 
+    // consumer thread, or after the thread has stopped
     void clear() { m_queue.clear(); }
 
+    // producer thread, an empty item lets the consumer leave take() and process events
     void wakeup()
     {
         if (m_queue.isEmpty()) {
-            m_queue.push_front(T());
+            m_queue.push_back(T());
+        }
+        wakeScheduled();
+    }
+
+    // producer thread, nothing is appended after it; the consumer flushes what is queued, drains
+    // the next stage and then marks itself drained
+    void setEof()
+    {
+        if (m_contextInfo == nullptr || !m_contextInfo->isIndexVaild()) {
+            return;
         }
+        m_eof = true;
+        m_queue.push_back(T());
+        wakeScheduled();
     }
 
+    void waitDrained() { m_drained.wait(false); }
+    [[nodiscard]] auto isDrained() const -> bool { return m_drained.load(); }
+
+    // wakes up waitDrained() without draining, e.g. on close
+    virtual void cancelDrain() { markDrained(); }
+
     void addEvent(const EventPtr &event)
     {
         if (!m_contextInfo->isIndexVaild()) {
@@ -93,6 +189,26 @@ public:
 protected:
     virtual void runDecoder() = 0;
 
+    // caller thread of startDecoder()/stopDecoder() in pooled mode, no slice is running
+    virtual void startPooled() {}
+    virtual void stopPooled() {}
+
+    void wakeScheduled()
+    {
+        if (m_scheduled.load()) {
+            DecoderScheduler::instance()->wake(this);
+        }
+    }
+
+    // consumer thread, after an empty item was taken
+    [[nodiscard]] auto isEofReached() const -> bool { return m_eof.load() && m_queue.isEmpty(); }
+
+    void markDrained()
+    {
+        m_drained = true;
+        m_drained.notify_all();
+    }
+
     void run() final
     {
         assertVaild();
@@ -100,6 +216,7 @@ protected:
             return;
         }
         runDecoder();
+        markDrained();
     }
 
     void assertVaild()
@@ -108,11 +225,179 @@ protected:
         Q_ASSERT(m_contextInfo != nullptr);
     }
 
-    Utils::BoundedBlockingQueue<T> m_queue;
+    Utils::SpscQueue<T> m_queue;
     Utils::ConcurrentQueue<EventPtr> m_eventQueue;
     AVContextInfo *m_contextInfo = nullptr;
     FormatContext *m_formatContext = nullptr;
     std::atomic_bool m_runing = true;
+    std::atomic_bool m_eof = false;
+    std::atomic_bool m_drained = true;
+    std::atomic_bool m_pooled = false;
+    std::atomic_bool m_scheduled = false;
+};
+
+// A decoder stage feeding a display stage, the packets of one stream are decoded into Output
+// items for m_nextStage. The own thread loop, the pooled slices with their pending output and
+// the end of stream handshake are shared; subclasses only decode.
+template<typename Output>
+class PacketDecoder : public Decoder<PacketPtr>
+{
+public:
+    using OutputList = std::vector<Output>;
+
+    explicit PacketDecoder(QObject *parent = nullptr)
+        : Decoder<PacketPtr>(parent)
+    {}
+
+    void cancelDrain() override
+    {
+        Decoder<PacketPtr>::cancelDrain();
+        m_nextStage->cancelDrain();
+    }
+
+    auto runSlice(qint64 deadline, qint64 &waitUntil) -> SliceResult final
+    {
+        while (m_runing.load()) {
+            processEvent();
+
+            if (!appendPending()) {
+                waitUntil = av_gettime_relative() + s_pooledRetryMicroseconds;
+                return SliceResult::Wait;
+            }
+            if (m_draining) {
+                return finishDrain(waitUntil);
+            }
+            if (av_gettime_relative() >= deadline) {
+                return SliceResult::Yield;
+            }
+
+            PacketPtr packetPtr;
+            if (!m_queue.tryTake(packetPtr)) {
+                return SliceResult::Idle;
+            }
+            if (nullptr == packetPtr) {
+                if (isEofReached()) {
+                    addPending(decodePacket(Packet::create()));
+                    m_draining = true;
+                }
+                continue;
+            }
+            addPending(decodePacket(packetPtr));
+        }
+        return SliceResult::Idle;
+    }
+
+protected:
+    // the items of one packet for the next stage, an empty packet flushes the delayed ones at the
+    // end of the stream
+    virtual auto decodePacket(const PacketPtr &packetPtr) -> OutputList = 0;
+    // decoder side state, on start and after a seek
+    virtual void resetDecode() {}
+
+    void runDecoder() final
+    {
+        resetDecode();
+        m_nextStage->startDecoder(m_formatContext, m_contextInfo);
+
+        while (m_runing.load()) {
+            processEvent();
+
+            auto packetPtr(m_queue.take());
+            if (nullptr == packetPtr) {
+                if (isEofReached()) {
+                    appendNext(decodePacket(Packet::create()));
+                    m_nextStage->setEof();
+                    m_nextStage->waitDrained();
+                    break;
+                }
+                continue;
+            }
+            appendNext(decodePacket(packetPtr));
+        }
+        m_nextStage->stopDecoder();
+    }
+
+    void startPooled() final
+    {
+        m_pending.clear();
+        m_draining = false;
+        m_eofSent = false;
+        resetDecode();
+        m_nextStage->startDecoder(m_formatContext, m_contextInfo);
+    }
+
+    void stopPooled() final
+    {
+        m_nextStage->stopDecoder();
+        m_pending.clear();
+    }
+
+    Decoder<Output> *m_nextStage = nullptr; // set by the subclass, a child of it
+
+private:
+    void processEvent()
+    {
+        while (m_runing.load() && !m_eventQueue.isEmpty()) {
+            auto eventPtr = m_eventQueue.take();
+            switch (eventPtr->type()) {
+            case Event::EventType::Pause: m_nextStage->addEvent(eventPtr); break;
+            case Event::EventType::Seek: {
+                auto *seekEvent = static_cast<SeekEvent *>(eventPtr.data());
+                seekEvent->countDown();
+                clear();
+                m_pending.clear();
+                resetDecode();
+                m_nextStage->addEvent(eventPtr);
+            } break;
+            default: break;
+            }
+        }
+    }
+
+    void appendNext(const OutputList &outputs)
+    {
+        for (const auto &output : outputs) {
+            m_nextStage->append(output);
+        }
+    }
+
+    // pooled mode, the next stage only takes what fits without blocking
+    void addPending(const OutputList &outputs)
+    {
+        m_pending.insert(m_pending.end(), outputs.cbegin(), outputs.cend());
+    }
+
+    auto appendPending() -> bool
+    {
+        while (!m_pending.empty()) {
+            if (m_nextStage->isFull()) {
+                return false;
+            }
+            m_nextStage->append(m_pending.front());
+            m_pending.pop_front();
+        }
+        return true;
+    }
+
+    auto finishDrain(qint64 &waitUntil) -> SliceResult
+    {
+        if (!m_eofSent) {
+            m_nextStage->setEof();
+            m_eofSent = true;
+        }
+        if (!m_nextStage->isDrained()) {
+            waitUntil = av_gettime_relative() + s_pooledRetryMicroseconds;
+            return SliceResult::Wait;
+        }
+        m_nextStage->stopDecoder();
+        markDrained();
+        return SliceResult::Finished;
+    }
+
+    // pooled mode
+    std::deque<Output> m_pending;
+    bool m_draining = false;
+    bool m_eofSent = false;
 };
 
 } // namespace Ffmpeg
@@ -0,0 +1,222 @@
+#include "decoderscheduler.hpp"
+
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <deque>
+#include <map>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+namespace Ffmpeg {
+
+static constexpr qint64 s_sliceMicroseconds = 5 * 1000;
+
+class DecoderScheduler::DecoderSchedulerPrivate
+{
+public:
+    enum class State { Idle, Queued, Running, RunningWoken, Waiting, Finished };
+
+    explicit DecoderSchedulerPrivate(DecoderScheduler *q)
+        : q_ptr(q)
+    {}
+
+    ~DecoderSchedulerPrivate()
+    {
+        {
+            QMutexLocker locker(&mutex);
+            quit = true;
+            workCondition.wakeAll();
+        }
+        for (auto *worker : std::as_const(workers)) {
+            worker->wait();
+            delete worker;
+        }
+    }
+
+    void startWorkers()
+    {
+        if (!workers.isEmpty()) {
+            return;
+        }
+        for (int i = 0; i < threadCount; ++i) {
+            auto *worker = QThread::create([this] { work(); });
+            worker->setObjectName(QString("DecoderWorker%1").arg(i));
+            worker->start();
+            workers.append(worker);
+        }
+    }
+
+    void enqueue(DecoderTask *task)
+    {
+        states[task] = State::Queued;
+        runQueue.push_back(task);
+        workCondition.wakeOne();
+    }
+
+    void eraseTimer(DecoderTask *task)
+    {
+        for (auto iter = timers.begin(); iter != timers.end(); ++iter) {
+            if (iter->second == task) {
+                timers.erase(iter);
+                return;
+            }
+        }
+    }
+
+    void eraseQueued(DecoderTask *task)
+    {
+        for (auto iter = runQueue.begin(); iter != runQueue.end(); ++iter) {
+            if (*iter == task) {
+                runQueue.erase(iter);
+                return;
+            }
+        }
+    }
+
+    // mutex locked
+    void expireTimers()
+    {
+        auto now = av_gettime_relative();
+        while (!timers.empty() && timers.begin()->first <= now) {
+            auto *task = timers.begin()->second;
+            timers.erase(timers.begin());
+            states[task] = State::Queued;
+            runQueue.push_back(task);
+        }
+    }
+
+    void work()
+    {
+        QMutexLocker locker(&mutex);
+        while (!quit) {
+            expireTimers();
+            if (runQueue.empty()) {
+                if (timers.empty()) {
+                    workCondition.wait(&mutex);
+                } else {
+                    auto timeout = (timers.begin()->first - av_gettime_relative()) / 1000 + 1;
+                    workCondition.wait(&mutex, QDeadlineTimer(qMax(timeout, 1LL)));
+                }
+                continue;
+            }
+            auto *task = runQueue.front();
+            runQueue.pop_front();
+            states[task] = State::Running;
+            locker.unlock();
+
+            qint64 waitUntil = 0;
+            auto result = task->runSlice(av_gettime_relative() + s_sliceMicroseconds, waitUntil);
+
+            locker.relock();
+            auto woken = states.value(task) == State::RunningWoken;
+            switch (result) {
+            case DecoderTask::SliceResult::Finished: states[task] = State::Finished; break;
+            case DecoderTask::SliceResult::Yield: enqueue(task); break;
+            case DecoderTask::SliceResult::Idle:
+                if (woken) {
+                    enqueue(task);
+                } else {
+                    states[task] = State::Idle;
+                }
+                break;
+            case DecoderTask::SliceResult::Wait:
+                if (woken) {
+                    enqueue(task);
+                } else {
+                    states[task] = State::Waiting;
+                    timers.emplace(waitUntil, task);
+                }
+                break;
+            }
+            doneCondition.wakeAll();
+        }
+    }
+
+    DecoderScheduler *q_ptr;
+
+    int threadCount = qMax(1, QThread::idealThreadCount());
+    QList<QThread *> workers;
+    bool quit = false;
+
+    QMutex mutex;
+    QWaitCondition workCondition;
+    QWaitCondition doneCondition;
+    QHash<DecoderTask *, State> states;
+    std::deque<DecoderTask *> runQueue;
+    std::multimap<qint64, DecoderTask *> timers;
+};
+
+DecoderScheduler::DecoderScheduler(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new DecoderSchedulerPrivate(this))
+{}
+
+DecoderScheduler::~DecoderScheduler() = default;
+
+void DecoderScheduler::setThreadCount(int count)
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    if (!d_ptr->workers.isEmpty()) {
+        qWarning() << "DecoderScheduler is already running with" << d_ptr->workers.size()
+                   << "threads";
+        return;
+    }
+    d_ptr->threadCount = qMax(1, count);
+}
+
+auto DecoderScheduler::threadCount() const -> int
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    return d_ptr->threadCount;
+}
+
+void DecoderScheduler::add(DecoderTask *task)
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->startWorkers();
+    d_ptr->enqueue(task);
+}
+
+void DecoderScheduler::remove(DecoderTask *task)
+{
+    using State = DecoderSchedulerPrivate::State;
+    QMutexLocker locker(&d_ptr->mutex);
+    forever {
+        auto state = d_ptr->states.value(task, State::Finished);
+        if (state != State::Running && state != State::RunningWoken) {
+            break;
+        }
+        d_ptr->doneCondition.wait(&d_ptr->mutex);
+    }
+    d_ptr->eraseQueued(task);
+    d_ptr->eraseTimer(task);
+    d_ptr->states.remove(task);
+}
+
+void DecoderScheduler::wake(DecoderTask *task)
+{
+    using State = DecoderSchedulerPrivate::State;
+    QMutexLocker locker(&d_ptr->mutex);
+    auto iter = d_ptr->states.find(task);
+    if (iter == d_ptr->states.end()) {
+        return;
+    }
+    switch (iter.value()) {
+    case State::Idle: d_ptr->enqueue(task); break;
+    case State::Waiting:
+        d_ptr->eraseTimer(task);
+        d_ptr->enqueue(task);
+        break;
+    case State::Running: iter.value() = State::RunningWoken; break;
+    default: break;
+    }
+}
+
+} // namespace Ffmpeg
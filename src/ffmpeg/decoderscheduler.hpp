@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ffmepg_global.h"
+
+#include <QObject>
+
+#include <utils/singleton.hpp>
+
+namespace Ffmpeg {
+
+// Work of a decoder stage that runs on the shared worker pool. A slice never blocks: it returns
+// when the deadline is reached, when no input is ready or when the next stage is full.
+class FFMPEG_EXPORT DecoderTask
+{
+public:
+    enum class SliceResult {
+        Yield,   // deadline reached, more work is ready
+        Idle,    // nothing to do until wake()
+        Wait,    // retry at waitUntil, or earlier on wake()
+        Finished // never run again
+    };
+
+    virtual ~DecoderTask() = default;
+
+    // deadline and waitUntil are av_gettime_relative() microseconds
+    virtual auto runSlice(qint64 deadline, qint64 &waitUntil) -> SliceResult = 0;
+};
+
+// Runs the decoder tasks of all players on a fixed number of worker threads. Runnable tasks are
+// served round robin, each for one time slice, so no player can starve the others.
+class FFMPEG_EXPORT DecoderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    // takes effect before the first task is added, default QThread::idealThreadCount()
+    void setThreadCount(int count);
+    [[nodiscard]] auto threadCount() const -> int;
+
+    void add(DecoderTask *task);
+    // blocks while a slice of the task is running
+    void remove(DecoderTask *task);
+    // new input or event for the task
+    void wake(DecoderTask *task);
+
+private:
+    explicit DecoderScheduler(QObject *parent = nullptr);
+    ~DecoderScheduler() override;
+
+    class DecoderSchedulerPrivate;
+    QScopedPointer<DecoderSchedulerPrivate> d_ptr;
+
+    SINGLETON(DecoderScheduler)
+};
+
+} // namespace Ffmpeg
@@ -19,6 +19,7 @@ public:
         CacheSpeed,
         SeekChanged,
         PreviewFramesChanged,
+        PreviewFrame,
         AVError,
         Error
     };
@@ -2,6 +2,7 @@
 
 #include "event.hpp"
 
+#include <ffmpeg/frame.hpp>
 #include <ffmpeg/mediainfo.hpp>
 
 namespace Ffmpeg {
@@ -74,6 +75,32 @@ private:
     qint64 m_speed = 0;
 };
 
+// one frame of the preview strip as soon as it is decoded, in any order
+class FFMPEG_EXPORT PreviewFrameEvent : public PropertyChangeEvent
+{
+public:
+    explicit PreviewFrameEvent(int index,
+                               int count,
+                               const FramePtr &framePtr,
+                               QObject *parent = nullptr)
+        : PropertyChangeEvent(parent)
+        , m_index(index)
+        , m_count(count)
+        , m_framePtr(framePtr)
+    {}
+
+    [[nodiscard]] auto type() const -> EventType override { return EventType::PreviewFrame; }
+
+    [[nodiscard]] auto index() const -> int { return m_index; }
+    [[nodiscard]] auto count() const -> int { return m_count; }
+    [[nodiscard]] auto frame() const -> FramePtr { return m_framePtr; }
+
+private:
+    int m_index = 0;
+    int m_count = 0;
+    FramePtr m_framePtr;
+};
+
 class PauseEvent : public Event
 {
 public:
@@ -25,7 +25,7 @@ public:
     void initVideoFilter(const FramePtr &framePtr)
     {
         buffersrcCtx = new FilterContext("buffer", q_ptr);
-        buffersinkCtx = new FilterContext("buffersink", q_ptr);
+        createSinks("buffersink");
         auto *avFrame = framePtr->avFrame();
         auto timeBase = avFrame->time_base;
         auto sampleAspectRatio = avFrame->sample_aspect_ratio;
@@ -46,7 +46,7 @@ public:
     void initAudioFilter(const FramePtr &framePtr)
     {
         buffersrcCtx = new FilterContext("abuffer", q_ptr);
-        buffersinkCtx = new FilterContext("abuffersink", q_ptr);
+        createSinks("abuffersink");
         auto *avFrame = framePtr->avFrame();
         if (avFrame->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) {
             av_channel_layout_default(&avFrame->ch_layout, avFrame->ch_layout.nb_channels);
@@ -63,10 +63,25 @@ public:
         create(args);
     }
 
+    void createSinks(const QString &name)
+    {
+        buffersinkCtxs.clear();
+        for (int i = 0; i < outputCount; i++) {
+            buffersinkCtxs.append(new FilterContext(name, q_ptr));
+        }
+    }
+
+    [[nodiscard]] auto sinkName(int index) const -> QString
+    {
+        return outputCount > 1 ? QString("out%1").arg(index) : QString("out");
+    }
+
     void create(const QString &args) const
     {
         buffersrcCtx->create("in", args, filterGraph);
-        buffersinkCtx->create("out", "", filterGraph);
+        for (int i = 0; i < buffersinkCtxs.size(); i++) {
+            buffersinkCtxs.at(i)->create(sinkName(i), "", filterGraph);
+        }
     }
 
     void config(const QString &filterSpec) const
@@ -81,10 +96,17 @@ public:
         outputs->pad_idx = 0;
         outputs->next = nullptr;
 
-        inputs->name = av_strdup("out");
-        inputs->filter_ctx = buffersinkCtx->avFilterContext();
-        inputs->pad_idx = 0;
-        inputs->next = nullptr;
+        // one labeled input per sink, freed with the head of the list
+        for (int i = 0; i < buffersinkCtxs.size(); i++) {
+            if (i > 0) {
+                inputs->next = avfilter_inout_alloc();
+                inputs = inputs->next;
+            }
+            inputs->name = av_strdup(sinkName(i).toUtf8().constData());
+            inputs->filter_ctx = buffersinkCtxs.at(i)->avFilterContext();
+            inputs->pad_idx = 0;
+            inputs->next = nullptr;
+        }
 
         filterGraph->parse(filterSpec, fliterInPtr.data(), fliterOutPtr.data());
         filterGraph->config();
@@ -98,8 +120,9 @@ public:
 
     Filter *q_ptr;
 
+    int outputCount = 1;
     FilterContext *buffersrcCtx = nullptr;
-    FilterContext *buffersinkCtx = nullptr;
+    QList<FilterContext *> buffersinkCtxs;
     FilterGraph *filterGraph;
 };
 
@@ -115,8 +138,10 @@ auto Filter::isInitialized() const -> bool
     return d_ptr->buffersrcCtx != nullptr;
 }
 
-auto Filter::init(AVMediaType type, const FramePtr &framePtr) -> bool
+auto Filter::init(AVMediaType type, const FramePtr &framePtr, int outputCount) -> bool
 {
+    Q_ASSERT(outputCount > 0);
+    d_ptr->outputCount = outputCount;
     switch (type) {
     case AVMEDIA_TYPE_AUDIO: d_ptr->initAudioFilter(framePtr); break;
     case AVMEDIA_TYPE_VIDEO: d_ptr->initVideoFilter(framePtr); break;
@@ -131,25 +156,38 @@ void Filter::config(const QString &filterSpec)
     d_ptr->config(filterSpec);
 }
 
+auto Filter::outputCount() const -> int
+{
+    return d_ptr->outputCount;
+}
+
 auto Filter::filterFrame(const FramePtr &framePtr) -> FramePtrList
 {
-    FramePtrList framepPtrs{};
+    return filterFrames(framePtr).value(0);
+}
+
+auto Filter::filterFrames(const FramePtr &framePtr) -> QList<FramePtrList>
+{
+    QList<FramePtrList> outputs(d_ptr->buffersinkCtxs.size());
     if (!d_ptr->buffersrcCtx->buffersrcAddFrameFlags(framePtr)) {
-        return framepPtrs;
+        return outputs;
     }
-    FramePtr outPtr(new Frame);
-    while (d_ptr->buffersinkCtx->buffersinkGetFrame(outPtr)) {
-        outPtr->setPictType(AV_PICTURE_TYPE_NONE);
-        framepPtrs.push_back(outPtr);
-        outPtr = std::make_shared<Frame>();
+    for (int i = 0; i < d_ptr->buffersinkCtxs.size(); i++) {
+        auto *buffersinkCtx = d_ptr->buffersinkCtxs.at(i);
+        auto outPtr = Frame::create();
+        while (buffersinkCtx->buffersinkGetFrame(outPtr)) {
+            outPtr->setPictType(AV_PICTURE_TYPE_NONE);
+            outputs[i].push_back(outPtr);
+            outPtr = Frame::create();
+        }
     }
-    return framepPtrs;
+    return outputs;
 }
 
-auto Filter::buffersinkCtx() -> FilterContext *
+auto Filter::buffersinkCtx(int index) -> FilterContext *
 {
-    Q_ASSERT(d_ptr->buffersinkCtx);
-    return d_ptr->buffersinkCtx;
+    Q_ASSERT(index >= 0 && index < d_ptr->buffersinkCtxs.size());
+    return d_ptr->buffersinkCtxs.at(index);
 }
 
 auto Filter::scale(const QSize &size) -> QString
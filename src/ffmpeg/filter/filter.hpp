@@ -23,15 +23,21 @@ public:
 
     [[nodiscard]] auto isInitialized() const -> bool;
 
-    auto init(AVMediaType type, const FramePtr &framePtr) -> bool;
+    // outputCount > 1 creates the sinks "out0", "out1"..., the filter spec has to feed each of
+    // them, e.g. "split=2[s0][s1];[s0]scale=1280:720[out0];[s1]scale=640:360[out1]"
+    auto init(AVMediaType type, const FramePtr &framePtr, int outputCount = 1) -> bool;
     // default args:
     // Video is "null"
     // Audio is "anull"
     void config(const QString &filterSpec);
 
+    [[nodiscard]] auto outputCount() const -> int;
+
     auto filterFrame(const FramePtr &framePtr) -> FramePtrList;
+    // the frames of every output, in output order
+    auto filterFrames(const FramePtr &framePtr) -> QList<FramePtrList>;
 
-    auto buffersinkCtx() -> FilterContext *;
+    auto buffersinkCtx(int index = 0) -> FilterContext *;
 
     static auto scale(const QSize &size) -> QString;
     static auto eq(const MediaConfig::Equalizer &equalizer) -> QString;
@@ -67,15 +67,65 @@ public:
         }
     }
 
+    // same rule as ffplay, timestamps of these formats are unreliable for seeking
+    [[nodiscard]] auto canSeekByte() const -> bool
+    {
+        const auto *iformat = formatCtx->iformat;
+        return (iformat->flags & AVFMT_NO_BYTE_SEEK) == 0
+               && (iformat->flags & AVFMT_TS_DISCONT) != 0 && strcmp(iformat->name, "ogg") != 0;
+    }
+
     [[nodiscard]] auto findBestStreamIndex(AVMediaType type) const -> int
     {
         Q_ASSERT(formatCtx != nullptr);
         return av_find_best_stream(formatCtx, type, -1, -1, nullptr, 0);
     }
 
+    static auto interruptCallback(void *opaque) -> int
+    {
+        auto *d = static_cast<FormatContextPrivate *>(opaque);
+        return d->interrupt && d->interrupt() ? 1 : 0;
+    }
+
+    // the resized buffer in front of the opened io, which writes through
+#if FF_API_AVIO_WRITE_NONCONST
+    static auto writeCallback(void *opaque, uint8_t *buf, int size) -> int
+#else
+    static auto writeCallback(void *opaque, const uint8_t *buf, int size) -> int
+#endif
+    {
+        auto *d = static_cast<FormatContextPrivate *>(opaque);
+        avio_write(d->ioCtx, buf, size);
+        return d->ioCtx->error < 0 ? d->ioCtx->error : size;
+    }
+
+    static auto seekCallback(void *opaque, int64_t offset, int whence) -> int64_t
+    {
+        auto *d = static_cast<FormatContextPrivate *>(opaque);
+        if ((whence & AVSEEK_SIZE) != 0) {
+            return avio_size(d->ioCtx);
+        }
+        return avio_seek(d->ioCtx, offset, whence & ~AVSEEK_FORCE);
+    }
+
+    void closeIo()
+    {
+        if (ioCtx == nullptr) {
+            avio_closep(&formatCtx->pb);
+            return;
+        }
+        avio_flush(formatCtx->pb);
+        av_freep(&formatCtx->pb->buffer);
+        avio_context_free(&formatCtx->pb);
+        avio_closep(&ioCtx);
+    }
+
     FormatContext *q_ptr;
 
     AVFormatContext *formatCtx = nullptr;
+    AVIOContext *ioCtx = nullptr; // behind formatCtx->pb when the buffer is resized
+    int ioBufferSize = 0;
+    std::function<bool()> interrupt;
     QString filepath;
     FormatContext::OpenMode mode = FormatContext::ReadOnly;
     bool isOpen = false;
@@ -153,6 +203,13 @@ auto FormatContext::openFilePath(const QString &filepath, OpenMode mode) -> bool
     auto inpuUrl = convertUrlToFfmpegInput(d_ptr->filepath);
     switch (mode) {
     case ReadOnly: {
+        d_ptr->formatCtx = avformat_alloc_context();
+        if (d_ptr->formatCtx == nullptr) {
+            SET_ERROR_CODE(AVERROR(ENOMEM));
+            return false;
+        }
+        d_ptr->formatCtx->interrupt_callback.callback = FormatContextPrivate::interruptCallback;
+        d_ptr->formatCtx->interrupt_callback.opaque = d_ptr.data();
         auto ret = avformat_open_input(&d_ptr->formatCtx, inpuUrl.constData(), nullptr, nullptr);
         if (ret != 0) {
             SET_ERROR_CODE(ret);
@@ -194,6 +251,16 @@ void FormatContext::close()
     }
 }
 
+void FormatContext::setIoBufferSize(int size)
+{
+    d_ptr->ioBufferSize = size;
+}
+
+auto FormatContext::ioBufferSize() const -> int
+{
+    return d_ptr->ioBufferSize;
+}
+
 auto FormatContext::avioOpen() -> bool
 {
     Q_ASSERT(d_ptr->formatCtx != nullptr);
@@ -201,8 +268,35 @@ auto FormatContext::avioOpen() -> bool
         return false;
     }
     auto inpuUrl = convertUrlToFfmpegInput(d_ptr->filepath);
-    auto ret = ::avio_open(&d_ptr->formatCtx->pb, inpuUrl.constData(), AVIO_FLAG_WRITE);
-    ERROR_RETURN(ret)
+    if (d_ptr->ioBufferSize <= 0) {
+        auto ret = ::avio_open(&d_ptr->formatCtx->pb, inpuUrl.constData(), AVIO_FLAG_WRITE);
+        ERROR_RETURN(ret)
+    }
+    auto ret = ::avio_open(&d_ptr->ioCtx, inpuUrl.constData(), AVIO_FLAG_WRITE);
+    if (ret < 0) {
+        SET_ERROR_CODE(ret);
+        return false;
+    }
+    d_ptr->ioCtx->direct = 1; // only buffer once
+    auto *buffer = static_cast<unsigned char *>(av_malloc(d_ptr->ioBufferSize));
+    if (buffer != nullptr) {
+        d_ptr->formatCtx->pb = avio_alloc_context(buffer,
+                                                  d_ptr->ioBufferSize,
+                                                  1,
+                                                  d_ptr.data(),
+                                                  nullptr,
+                                                  FormatContextPrivate::writeCallback,
+                                                  FormatContextPrivate::seekCallback);
+    }
+    if (d_ptr->formatCtx->pb == nullptr) {
+        av_free(buffer);
+        avio_closep(&d_ptr->ioCtx);
+        SET_ERROR_CODE(AVERROR(ENOMEM));
+        return false;
+    }
+    d_ptr->formatCtx->pb->seekable = d_ptr->ioCtx->seekable;
+    d_ptr->formatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    return true;
 }
 
 void FormatContext::avioClose()
@@ -211,7 +305,7 @@ void FormatContext::avioClose()
         return;
     }
     if ((d_ptr->formatCtx != nullptr) && ((d_ptr->formatCtx->oformat->flags & AVFMT_NOFILE) == 0)) {
-        avio_closep(&d_ptr->formatCtx->pb);
+        d_ptr->closeIo();
     }
     avformat_free_context(d_ptr->formatCtx);
     d_ptr->formatCtx = nullptr;
@@ -317,7 +411,20 @@ auto FormatContext::readFrame(const PacketPtr &packetPtr) -> bool
 {
     Q_ASSERT(d_ptr->formatCtx != nullptr);
     int ret = av_read_frame(d_ptr->formatCtx, packetPtr->avPacket());
-    ERROR_RETURN(ret)
+    if (ret == AVERROR_EXIT) { // interrupted by the callback
+        return false;
+    }
+    if (ret < 0) {
+        SET_ERROR_CODE(ret);
+        return false;
+    }
+    packetPtr->trackMemory();
+    return true;
+}
+
+void FormatContext::setInterruptCallback(const std::function<bool()> &callback)
+{
+    d_ptr->interrupt = callback;
 }
 
 auto FormatContext::checkPktPlayRange(const PacketPtr &packetPtr) -> bool
@@ -379,6 +486,9 @@ auto FormatContext::seek(qint64 timestamp, bool forward) -> bool
     auto seekMin = forward ? INT64_MIN : timestamp - d_ptr->seekOffset;
     auto seekMax = forward ? timestamp + d_ptr->seekOffset : INT64_MAX;
     auto ret = avformat_seek_file(d_ptr->formatCtx, -1, seekMin, timestamp, seekMax, 0);
+    if (ret == AVERROR_EXIT) { // interrupted by the callback
+        return false;
+    }
     ERROR_RETURN(ret)
 }
 
@@ -389,6 +499,39 @@ auto FormatContext::seekFrame(int index, qint64 timestamp) -> bool
     ERROR_RETURN(ret)
 }
 
+auto FormatContext::keyFrameIndex() const -> KeyFrameIndexPtr
+{
+    if (!d_ptr->isOpen || d_ptr->mode != ReadOnly) {
+        return {};
+    }
+    return KeyFrameIndexer::instance()->index(d_ptr->filepath);
+}
+
+auto FormatContext::seekKeyFrame(int index, qint64 timestamp, bool forward) -> bool
+{
+    Q_ASSERT(d_ptr->formatCtx != nullptr);
+    auto indexPtr = keyFrameIndex();
+    auto *stream = d_ptr->formatCtx->streams[index];
+    auto pts = av_rescale_q_rnd(timestamp,
+                                AV_TIME_BASE_Q,
+                                stream->time_base,
+                                forward ? AV_ROUND_UP : AV_ROUND_DOWN);
+    KeyFrame keyFrame;
+    if (indexPtr.isNull() || !indexPtr->find(index, pts, forward, keyFrame)) {
+        return seek(timestamp, forward);
+    }
+    int ret = 0;
+    if (keyFrame.position >= 0 && d_ptr->canSeekByte()) {
+        ret = av_seek_frame(d_ptr->formatCtx, index, keyFrame.position, AVSEEK_FLAG_BYTE);
+    } else {
+        ret = av_seek_frame(d_ptr->formatCtx, index, keyFrame.pts, AVSEEK_FLAG_BACKWARD);
+    }
+    if (ret == AVERROR_EXIT) { // interrupted by the callback
+        return false;
+    }
+    ERROR_RETURN(ret)
+}
+
 void FormatContext::dumpFormat()
 {
     Q_ASSERT(d_ptr->formatCtx != nullptr);
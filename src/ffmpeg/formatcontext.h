@@ -1,11 +1,14 @@
 #pragma once
 
 #include "ffmepg_global.h"
+#include "keyframeindex.hpp"
 #include "mediainfo.hpp"
 #include "packet.hpp"
 
 #include <QObject>
 
+#include <functional>
+
 extern "C" {
 #include <libavutil/avutil.h>
 }
@@ -29,6 +32,11 @@ public:
     auto openFilePath(const QString &filepath, OpenMode mode = ReadOnly) -> bool;
     void close();
 
+    // Write buffer of the output io, bytes; a larger one rides out stalls of slow disks and
+    // network shares, <= 0 keeps ffmpeg's default. Takes effect in avioOpen()
+    void setIoBufferSize(int size);
+    [[nodiscard]] auto ioBufferSize() const -> int;
+
     auto avioOpen() -> bool;
     void avioClose();
 
@@ -55,8 +63,19 @@ public:
     auto seek(qint64 timestamp, bool forward) -> bool;   // microsecond
     auto seekFrame(int index, qint64 timestamp) -> bool; // microsecond
 
+    // Key frames of the opened local file from KeyFrameIndexer, null until the background scan
+    // is done (the first call starts it)
+    [[nodiscard]] auto keyFrameIndex() const -> KeyFrameIndexPtr;
+    // Straight to the key frame of the stream at or before the timestamp (microsecond), or with
+    // forward the first one at or after it; by its byte offset where the demuxer allows it.
+    // Without the index or such a key frame like seek(timestamp, forward)
+    auto seekKeyFrame(int index, qint64 timestamp, bool forward = false) -> bool;
+
     auto readFrame(const PacketPtr &packetPtr) -> bool;
 
+    // Blocking demuxer io (open, read, seek) is aborted while the callback returns true
+    void setInterruptCallback(const std::function<bool()> &callback);
+
     auto checkPktPlayRange(const PacketPtr &packetPt) -> bool;
 
     [[nodiscard]] auto guessFrameRate(int index) const -> AVRational;
@@ -1,6 +1,8 @@
 #include "frame.hpp"
 #include "averrormanager.hpp"
 #include "ffmpegutils.hpp"
+#include "memorybudget.hpp"
+#include "objectpool.hpp"
 #include "videoformat.hpp"
 
 #include <QImage>
@@ -11,6 +13,8 @@ extern "C" {
 
 namespace Ffmpeg {
 
+static constexpr auto s_maxPooledFrames = 256;
+
 struct AVFrameDeleter
 {
     void operator()(AVFrame *f) const noexcept { av_frame_free(&f); }
@@ -34,6 +38,13 @@ public:
     {
         freeImageAlloc();
         frame.reset();
+        untrackMemory();
+    }
+
+    void untrackMemory()
+    {
+        MemoryBudget::instance()->release(trackedBytes);
+        trackedBytes = 0;
     }
 
     void freeImageAlloc()
@@ -41,11 +52,15 @@ public:
         if (imageAlloc) {
             av_freep(&frame->data[0]);
             imageAlloc = false;
+            imageAllocBytes = 0;
+            untrackMemory();
         }
     }
 
     AVFramePtr frame;
     bool imageAlloc = false;
+    qint64 imageAllocBytes = 0; // av_image_alloc() has no AVBufferRef
+    qint64 trackedBytes = 0;
 };
 
 Frame::Frame()
@@ -54,6 +69,19 @@ Frame::Frame()
 
 Frame::~Frame() = default;
 
+auto Frame::create() -> std::shared_ptr<Frame>
+{
+    static ObjectPool<Frame> pool(s_maxPooledFrames, [](Frame *frame) {
+        if (!frame->d_ptr || !frame->d_ptr->frame) {
+            return false;
+        }
+        frame->freeImageAlloc();
+        frame->unref();
+        return true;
+    });
+    return pool.acquire();
+}
+
 Frame::Frame(const Frame &other)
     : d_ptr(std::make_unique<FramePrivate>())
 {
@@ -67,6 +95,7 @@ Frame &Frame::operator=(const Frame &other)
     if (this != &other) {
         d_ptr->freeImageAlloc();
         av_frame_unref(d_ptr->frame.get());
+        d_ptr->untrackMemory();
         av_frame_ref(d_ptr->frame.get(), other.d_ptr->frame.get());
     }
     return *this;
@@ -119,6 +148,8 @@ bool Frame::imageAlloc(const QSize &size, AVPixelFormat pix_fmt, int align)
         return false;
     }
     d_ptr->imageAlloc = true;
+    d_ptr->imageAllocBytes = ret;
+    trackMemory();
     return true;
 }
 
@@ -135,6 +166,7 @@ void Frame::setPictType(AVPictureType type)
 void Frame::unref()
 {
     av_frame_unref(d_ptr->frame.get());
+    d_ptr->untrackMemory();
 }
 
 void Frame::setPts(qint64 pts)
@@ -187,6 +219,32 @@ auto Frame::isKey() -> bool
     return d_ptr->frame->flags & AV_FRAME_FLAG_KEY;
 }
 
+auto Frame::bufferSize() -> qint64
+{
+    auto *f = d_ptr->frame.get();
+    qint64 size = 0;
+    for (auto *buf : f->buf) {
+        if (buf != nullptr) {
+            size += static_cast<qint64>(buf->size);
+        }
+    }
+    for (int i = 0; i < f->nb_extended_buf; ++i) {
+        size += static_cast<qint64>(f->extended_buf[i]->size);
+    }
+    if (size == 0 && d_ptr->imageAlloc) {
+        size = d_ptr->imageAllocBytes;
+    }
+    return size;
+}
+
+void Frame::trackMemory()
+{
+    auto size = bufferSize();
+    MemoryBudget::instance()->acquire(size - d_ptr->trackedBytes);
+    MemoryBudget::instance()->release(d_ptr->trackedBytes - size);
+    d_ptr->trackedBytes = size;
+}
+
 auto Frame::avFrame() -> AVFrame *
 {
     return d_ptr->frame.get();
@@ -208,8 +266,14 @@ auto Frame::fromQImage(const QImage &image) -> Frame *
     if (ptr->getBuffer() == false)
         return nullptr;
 
-    memcpy(f->data[0], img.constBits(), static_cast<size_t>(img.height()) * f->linesize[0]);
-    ptr->d_ptr->imageAlloc = true; // 标记内存由 av_malloc 分配
+    // the buffer belongs to buf[0], not imageAlloc; the line sizes of both sides may differ
+    av_image_copy_plane(f->data[0],
+                        f->linesize[0],
+                        img.constBits(),
+                        static_cast<int>(img.bytesPerLine()),
+                        img.width() * 4,
+                        img.height());
+    ptr->trackMemory();
     return ptr.release();
 }
 
@@ -26,6 +26,9 @@ public:
     Frame &operator=(Frame &&other) noexcept;
     ~Frame();
 
+    // Reuses a frame released by an earlier create() when possible
+    static auto create() -> std::shared_ptr<Frame>;
+
     auto compareProps(Frame *other) -> bool;
     void copyPropsFrom(Frame *src);
     auto imageAlloc(const QSize &size, AVPixelFormat pix_fmt = AV_PIX_FMT_RGBA, int align = 1)
@@ -41,6 +44,8 @@ public:
     auto toImage() -> QImage; // maybe null
     auto getBuffer() -> bool;
     auto isKey() -> bool;
+    auto bufferSize() -> qint64; // bytes referenced by all AVBufferRefs of the frame
+    void trackMemory(); // account bufferSize() in MemoryBudget until unref or destruction
     auto avFrame() -> AVFrame *;
 
     static auto fromQImage(const QImage &image) -> Frame *;
@@ -13,21 +13,6 @@ extern "C" {
 
 namespace Ffmpeg {
 
-AVPixelFormat hw_pix_fmt = AV_PIX_FMT_NONE;
-
-auto get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts) -> AVPixelFormat
-{
-    Q_UNUSED(ctx)
-    const enum AVPixelFormat *p;
-    for (p = pix_fmts; *p != -1; p++) {
-        if (*p == hw_pix_fmt) {
-            return *p;
-        }
-    }
-    qWarning() << "Failed to get HW surface format.";
-    return AV_PIX_FMT_NONE;
-}
-
 class HardWareDecode::HardWareDecodePrivate
 {
 public:
@@ -37,12 +22,28 @@ public:
         bufferRef = new BufferRef(q_ptr);
     }
 
-    ~HardWareDecodePrivate() { hw_pix_fmt = AV_PIX_FMT_NONE; }
+    ~HardWareDecodePrivate() = default;
+
+    // AVCodecContext::opaque carries the private of the decoder that owns the context
+    static auto getHwFormat(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts)
+        -> AVPixelFormat
+    {
+        auto *d = static_cast<HardWareDecodePrivate *>(ctx->opaque);
+        const enum AVPixelFormat *p;
+        for (p = pix_fmts; *p != -1; p++) {
+            if (*p == d->hw_pix_fmt) {
+                return *p;
+            }
+        }
+        qWarning() << "Failed to get HW surface format.";
+        return AV_PIX_FMT_NONE;
+    }
 
     HardWareDecode *q_ptr;
 
     QList<AVHWDeviceType> hwDeviceTypes = getCurrentHWDeviceTypes();
     AVHWDeviceType hwDeviceType = AV_HWDEVICE_TYPE_NONE;
+    AVPixelFormat hw_pix_fmt = AV_PIX_FMT_NONE;
     BufferRef *bufferRef;
     bool vaild = false;
 };
@@ -63,18 +64,18 @@ auto HardWareDecode::initPixelFormat(const AVCodec *decoder) -> bool
         return false;
     }
     for (AVHWDeviceType type : std::as_const(d_ptr->hwDeviceTypes)) {
-        hw_pix_fmt = getPixelFormat(decoder, type);
-        if (hw_pix_fmt != AV_PIX_FMT_NONE) {
+        d_ptr->hw_pix_fmt = getPixelFormat(decoder, type);
+        if (d_ptr->hw_pix_fmt != AV_PIX_FMT_NONE) {
             d_ptr->hwDeviceType = type;
             break;
         }
     }
-    return (hw_pix_fmt != AV_PIX_FMT_NONE);
+    return (d_ptr->hw_pix_fmt != AV_PIX_FMT_NONE);
 }
 
 auto HardWareDecode::initHardWareDevice(CodecContext *codecContext) -> bool
 {
-    if (hw_pix_fmt == AV_PIX_FMT_NONE) {
+    if (d_ptr->hw_pix_fmt == AV_PIX_FMT_NONE) {
         return false;
     }
     if (!d_ptr->bufferRef->hwdeviceCtxCreate(d_ptr->hwDeviceType)) {
@@ -82,7 +83,8 @@ auto HardWareDecode::initHardWareDevice(CodecContext *codecContext) -> bool
     }
     auto *ctx = codecContext->avCodecCtx();
     ctx->hw_device_ctx = d_ptr->bufferRef->ref();
-    ctx->get_format = get_hw_format;
+    ctx->opaque = d_ptr.data();
+    ctx->get_format = HardWareDecodePrivate::getHwFormat;
     d_ptr->vaild = ctx->hw_device_ctx != nullptr;
     return d_ptr->vaild;
 }
@@ -93,10 +95,10 @@ auto HardWareDecode::transFromGpu(const FramePtr &inPtr, bool &ok) -> FramePtr
     if (!isVaild()) {
         return inPtr;
     }
-    if (inPtr->avFrame()->format != hw_pix_fmt) {
+    if (inPtr->avFrame()->format != d_ptr->hw_pix_fmt) {
         return inPtr;
     }
-    FramePtr outPtr(new Frame);
+    auto outPtr = Frame::create();
     // 超级吃CPU 巨慢
     auto ret = av_hwframe_transfer_data(outPtr->avFrame(), inPtr->avFrame(), 0);
     // 如果把映射后的帧存起来，接下去解码会出问题；
@@ -118,7 +120,7 @@ auto HardWareDecode::isVaild() -> bool
     if (d_ptr->hwDeviceType == AV_HWDEVICE_TYPE_NONE) {
         return false;
     }
-    if (hw_pix_fmt == AV_PIX_FMT_NONE) {
+    if (d_ptr->hw_pix_fmt == AV_PIX_FMT_NONE) {
         return false;
     }
     return d_ptr->vaild;
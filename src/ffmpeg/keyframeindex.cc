@@ -0,0 +1,327 @@
+#include "keyframeindex.hpp"
+#include "formatcontext.h"
+#include "packet.hpp"
+#include "thumbnailcache.hpp"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSet>
+#include <QThreadPool>
+
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace Ffmpeg {
+
+class KeyFrameIndex::KeyFrameIndexPrivate
+{
+public:
+    struct Stream
+    {
+        AVRational timebase{0, 1};
+        KeyFrames keyFrames; // sorted by pts
+    };
+
+    explicit KeyFrameIndexPrivate(KeyFrameIndex *q)
+        : q_ptr(q)
+    {}
+
+    KeyFrameIndex *q_ptr;
+
+    QString filepath;
+    QString fileId;
+    QMap<int, Stream> streams;
+};
+
+KeyFrameIndex::KeyFrameIndex(const QString &filepath)
+    : d_ptr(new KeyFrameIndexPrivate(this))
+{
+    d_ptr->filepath = filepath;
+}
+
+KeyFrameIndex::~KeyFrameIndex() = default;
+
+auto KeyFrameIndex::filepath() const -> QString
+{
+    return d_ptr->filepath;
+}
+
+auto KeyFrameIndex::fileIdentity() const -> QString
+{
+    return d_ptr->fileId;
+}
+
+auto KeyFrameIndex::streamIndexs() const -> QList<int>
+{
+    return d_ptr->streams.keys();
+}
+
+auto KeyFrameIndex::timebase(int streamIndex) const -> AVRational
+{
+    return d_ptr->streams.value(streamIndex).timebase;
+}
+
+auto KeyFrameIndex::keyFrames(int streamIndex) const -> KeyFrames
+{
+    return d_ptr->streams.value(streamIndex).keyFrames;
+}
+
+auto KeyFrameIndex::find(int streamIndex, qint64 pts, bool forward, KeyFrame &keyFrame) const
+    -> bool
+{
+    auto iter = d_ptr->streams.constFind(streamIndex);
+    if (iter == d_ptr->streams.cend()) {
+        return false;
+    }
+    const auto &keyFrames = iter->keyFrames;
+    auto lessPts = [](const KeyFrame &a, const KeyFrame &b) { return a.pts < b.pts; };
+    KeyFrame target{pts, -1};
+    if (forward) {
+        auto it = std::lower_bound(keyFrames.cbegin(), keyFrames.cend(), target, lessPts);
+        if (it == keyFrames.cend()) {
+            return false;
+        }
+        keyFrame = *it;
+    } else {
+        auto it = std::upper_bound(keyFrames.cbegin(), keyFrames.cend(), target, lessPts);
+        if (it == keyFrames.cbegin()) {
+            return false;
+        }
+        keyFrame = *std::prev(it);
+    }
+    return true;
+}
+
+auto KeyFrameIndex::build(const std::function<bool()> &isCanceled) -> bool
+{
+    d_ptr->streams.clear();
+    // before the scan, a file written meanwhile is out of date at the next check
+    d_ptr->fileId = ThumbnailCache::fileIdentity(d_ptr->filepath);
+
+    // no avformat_find_stream_info(), it decodes; streams found later are picked up on the fly
+    FormatContext formatContext;
+    formatContext.setInterruptCallback(isCanceled);
+    if (!formatContext.openFilePath(d_ptr->filepath)) {
+        return false;
+    }
+    auto *formatCtx = formatContext.avFormatContext();
+    forever {
+        if (isCanceled && isCanceled()) {
+            return false;
+        }
+        auto packetPtr = Packet::create();
+        if (!formatContext.readFrame(packetPtr)) {
+            break;
+        }
+        auto *stream = formatCtx->streams[packetPtr->streamIndex()];
+        if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO
+            || (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) != 0) {
+            stream->discard = AVDISCARD_ALL;
+            continue;
+        }
+        if (!packetPtr->isKey()) {
+            continue;
+        }
+        auto *avPacket = packetPtr->avPacket();
+        auto pts = avPacket->pts != AV_NOPTS_VALUE ? avPacket->pts : avPacket->dts;
+        if (pts == AV_NOPTS_VALUE) {
+            continue;
+        }
+        auto &entry = d_ptr->streams[packetPtr->streamIndex()];
+        entry.timebase = stream->time_base;
+        entry.keyFrames.append({pts, avPacket->pos});
+    }
+    // canceled or an io error before the end, a partial index is not saved as a whole one
+    if ((isCanceled && isCanceled()) || (formatCtx->pb != nullptr && formatCtx->pb->error < 0)) {
+        return false;
+    }
+
+    for (auto &entry : d_ptr->streams) {
+        auto &keyFrames = entry.keyFrames;
+        std::stable_sort(keyFrames.begin(), keyFrames.end(), [](const auto &a, const auto &b) {
+            return a.pts < b.pts;
+        });
+        auto last = std::unique(keyFrames.begin(),
+                                keyFrames.end(),
+                                [](const auto &a, const auto &b) { return a.pts == b.pts; });
+        keyFrames.erase(last, keyFrames.end());
+    }
+    qInfo() << "Key frame index of" << d_ptr->filepath << "built," << d_ptr->streams.size()
+            << "video streams";
+    return true;
+}
+
+auto KeyFrameIndex::load(const QString &path) -> bool
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    auto object = QJsonDocument::fromJson(file.readAll()).object();
+    auto fileId = ThumbnailCache::fileIdentity(d_ptr->filepath);
+    if (object.value("identity").toString() != fileId) {
+        qInfo() << "Key frame index of" << d_ptr->filepath << "is out of date";
+        return false;
+    }
+    d_ptr->fileId = fileId;
+    d_ptr->streams.clear();
+    const auto streams = object.value("streams").toArray();
+    for (const auto &streamValue : streams) {
+        auto streamObject = streamValue.toObject();
+        KeyFrameIndexPrivate::Stream entry;
+        entry.timebase = AVRational{streamObject.value("num").toInt(),
+                                    streamObject.value("den").toInt(1)};
+        // pts and position pairs
+        const auto keyFrames = streamObject.value("keyFrames").toArray();
+        for (qsizetype i = 0; i + 1 < keyFrames.size(); i += 2) {
+            entry.keyFrames.append(
+                {keyFrames.at(i).toInteger(), keyFrames.at(i + 1).toInteger()});
+        }
+        d_ptr->streams.insert(streamObject.value("index").toInt(), entry);
+    }
+    return true;
+}
+
+auto KeyFrameIndex::save(const QString &path) const -> bool
+{
+    QJsonArray streams;
+    for (auto iter = d_ptr->streams.cbegin(); iter != d_ptr->streams.cend(); ++iter) {
+        QJsonArray keyFrames;
+        for (const auto &keyFrame : std::as_const(iter->keyFrames)) {
+            keyFrames.append(keyFrame.pts);
+            keyFrames.append(keyFrame.position);
+        }
+        streams.append(QJsonObject{{"index", iter.key()},
+                                   {"num", iter->timebase.num},
+                                   {"den", iter->timebase.den},
+                                   {"keyFrames", keyFrames}});
+    }
+    QJsonObject object{{"filepath", d_ptr->filepath},
+                       {"identity", d_ptr->fileId},
+                       {"streams", streams}};
+
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return false;
+    }
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot open the file:" << path << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+class KeyFrameIndexer::KeyFrameIndexerPrivate
+{
+public:
+    explicit KeyFrameIndexerPrivate(KeyFrameIndexer *q)
+        : q_ptr(q)
+    {
+        // one scan at a time, it is io bound
+        pool.setMaxThreadCount(1);
+    }
+
+    ~KeyFrameIndexerPrivate()
+    {
+        aborted.store(true);
+        pool.clear();
+        pool.waitForDone();
+    }
+
+    [[nodiscard]] auto sidecarPath(const QString &filepath) const -> QString
+    {
+        if (cachePath.isEmpty()) {
+            return {};
+        }
+        auto name = QCryptographicHash::hash(filepath.toUtf8(), QCryptographicHash::Sha1).toHex();
+        return QDir(cachePath).filePath(name + ".json");
+    }
+
+    void build(const QString &filepath)
+    {
+        QString path;
+        {
+            QMutexLocker locker(&mutex);
+            path = sidecarPath(filepath);
+        }
+        KeyFrameIndexPtr indexPtr(new KeyFrameIndex(filepath));
+        auto ok = !path.isEmpty() && indexPtr->load(path);
+        if (!ok) {
+            ok = indexPtr->build([this] { return aborted.load(); });
+            if (ok && !path.isEmpty()) {
+                indexPtr->save(path);
+            }
+        }
+
+        QMutexLocker locker(&mutex);
+        pending.remove(filepath);
+        if (ok) {
+            indexes.insert(filepath, indexPtr);
+        }
+    }
+
+    KeyFrameIndexer *q_ptr;
+
+    mutable QMutex mutex;
+    QString cachePath;
+    QHash<QString, KeyFrameIndexPtr> indexes;
+    QSet<QString> pending;
+    std::atomic_bool aborted = false;
+    QThreadPool pool;
+};
+
+KeyFrameIndexer::KeyFrameIndexer()
+    : d_ptr(new KeyFrameIndexerPrivate(this))
+{}
+
+KeyFrameIndexer::~KeyFrameIndexer() = default;
+
+void KeyFrameIndexer::setCachePath(const QString &path)
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->cachePath = path;
+}
+
+auto KeyFrameIndexer::cachePath() const -> QString
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    return d_ptr->cachePath;
+}
+
+auto KeyFrameIndexer::index(const QString &filepath) -> KeyFrameIndexPtr
+{
+    // a scan reads the whole input, too much for network streams
+    if (!QFileInfo(filepath).isFile()) {
+        return {};
+    }
+    auto fileId = ThumbnailCache::fileIdentity(filepath);
+    QMutexLocker locker(&d_ptr->mutex);
+    auto indexPtr = d_ptr->indexes.value(filepath);
+    if (!indexPtr.isNull() && indexPtr->fileIdentity() == fileId) {
+        return indexPtr;
+    }
+    d_ptr->indexes.remove(filepath);
+    if (!d_ptr->pending.contains(filepath) && !d_ptr->aborted.load()) {
+        d_ptr->pending.insert(filepath);
+        d_ptr->pool.start([this, filepath] { d_ptr->build(filepath); });
+    }
+    return {};
+}
+
+void KeyFrameIndexer::clear()
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->indexes.clear();
+}
+
+} // namespace Ffmpeg
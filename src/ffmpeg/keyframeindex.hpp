@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ffmepg_global.h"
+
+#include <utils/singleton.hpp>
+
+#include <QSharedPointer>
+
+#include <functional>
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+namespace Ffmpeg {
+
+struct FFMPEG_EXPORT KeyFrame
+{
+    qint64 pts = 0;       // stream time base
+    qint64 position = -1; // byte offset of the packet in the file, -1 if unknown
+};
+
+using KeyFrames = QList<KeyFrame>;
+
+// The key frames of the video streams of a file, from a packet level scan without decoding
+class FFMPEG_EXPORT KeyFrameIndex
+{
+public:
+    explicit KeyFrameIndex(const QString &filepath);
+    ~KeyFrameIndex();
+
+    [[nodiscard]] auto filepath() const -> QString;
+    // of the file when it was scanned, see ThumbnailCache::fileIdentity()
+    [[nodiscard]] auto fileIdentity() const -> QString;
+
+    [[nodiscard]] auto streamIndexs() const -> QList<int>;
+    [[nodiscard]] auto timebase(int streamIndex) const -> AVRational;
+    [[nodiscard]] auto keyFrames(int streamIndex) const -> KeyFrames;
+
+    // the last key frame at or before pts, or with forward the first one at or after it;
+    // stream time base
+    auto find(int streamIndex, qint64 pts, bool forward, KeyFrame &keyFrame) const -> bool;
+
+    // reads every packet of the file, stops when isCanceled returns true
+    auto build(const std::function<bool()> &isCanceled = nullptr) -> bool;
+
+    // sidecar file, the load fails if the file changed since it was saved
+    auto load(const QString &path) -> bool;
+    [[nodiscard]] auto save(const QString &path) const -> bool;
+
+private:
+    class KeyFrameIndexPrivate;
+    QScopedPointer<KeyFrameIndexPrivate> d_ptr;
+};
+
+using KeyFrameIndexPtr = QSharedPointer<KeyFrameIndex>;
+
+// Builds the key frame indexes of local files in the background, one file at a time, and keeps
+// them as sidecar files in the cache directory
+class FFMPEG_EXPORT KeyFrameIndexer
+{
+public:
+    // empty keeps the indexes in memory only
+    void setCachePath(const QString &path);
+    [[nodiscard]] auto cachePath() const -> QString;
+
+    // the index if it is ready, otherwise null and the index is built in the background
+    auto index(const QString &filepath) -> KeyFrameIndexPtr;
+    void clear();
+
+private:
+    KeyFrameIndexer();
+    ~KeyFrameIndexer();
+
+    class KeyFrameIndexerPrivate;
+    QScopedPointer<KeyFrameIndexerPrivate> d_ptr;
+
+    SINGLETON(KeyFrameIndexer)
+};
+
+} // namespace Ffmpeg
@@ -0,0 +1,117 @@
+#include "memorybudget.hpp"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <limits>
+
+namespace Ffmpeg {
+
+class MemoryBudget::MemoryBudgetPrivate
+{
+public:
+    explicit MemoryBudgetPrivate(MemoryBudget *q)
+        : q_ptr(q)
+    {}
+
+    void updatePeak(qint64 value)
+    {
+        auto peak = peakUsage.load();
+        while (value > peak && !peakUsage.compare_exchange_weak(peak, value)) {
+        }
+    }
+
+    MemoryBudget *q_ptr;
+
+    std::atomic<qint64> limit{std::numeric_limits<qint64>::max()};
+    std::atomic<qint64> usage{0};
+    std::atomic<qint64> peakUsage{0};
+
+    // release() only takes the mutex when somebody is waiting
+    std::atomic_int waiters{0};
+    QMutex mutex;
+    QWaitCondition waitCondition;
+};
+
+MemoryBudget::MemoryBudget()
+    : d_ptr(new MemoryBudgetPrivate(this))
+{}
+
+MemoryBudget::~MemoryBudget() = default;
+
+void MemoryBudget::setLimit(qint64 bytes)
+{
+    d_ptr->limit.store(bytes > 0 ? bytes : std::numeric_limits<qint64>::max());
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->waitCondition.wakeAll();
+}
+
+auto MemoryBudget::limit() const -> qint64
+{
+    return d_ptr->limit.load();
+}
+
+auto MemoryBudget::usage() const -> qint64
+{
+    return d_ptr->usage.load();
+}
+
+auto MemoryBudget::peakUsage() const -> qint64
+{
+    return d_ptr->peakUsage.load();
+}
+
+void MemoryBudget::resetPeakUsage()
+{
+    d_ptr->peakUsage.store(d_ptr->usage.load());
+}
+
+auto MemoryBudget::isExceeded() const -> bool
+{
+    return d_ptr->usage.load() >= d_ptr->limit.load();
+}
+
+void MemoryBudget::acquire(qint64 bytes)
+{
+    if (bytes <= 0) {
+        return;
+    }
+    d_ptr->updatePeak(d_ptr->usage.fetch_add(bytes) + bytes);
+}
+
+void MemoryBudget::release(qint64 bytes)
+{
+    if (bytes <= 0) {
+        return;
+    }
+    d_ptr->usage.fetch_sub(bytes);
+    if (d_ptr->waiters.load() > 0) {
+        QMutexLocker locker(&d_ptr->mutex);
+        d_ptr->waitCondition.wakeAll();
+    }
+}
+
+auto MemoryBudget::waitForBudget(int msecs) -> bool
+{
+    if (!isExceeded()) {
+        return true;
+    }
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->waiters.fetch_add(1);
+    if (isExceeded()) {
+        d_ptr->waitCondition.wait(&d_ptr->mutex, msecs);
+    }
+    d_ptr->waiters.fetch_sub(1);
+    return !isExceeded();
+}
+
+void MemoryReservation::setBytes(qint64 bytes)
+{
+    bytes = qMax<qint64>(0, bytes);
+    auto *memoryBudget = MemoryBudget::instance();
+    memoryBudget->acquire(bytes - m_bytes);
+    memoryBudget->release(m_bytes - bytes);
+    m_bytes = bytes;
+}
+
+} // namespace Ffmpeg
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ffmepg_global.h"
+
+#include <utils/singleton.hpp>
+
+namespace Ffmpeg {
+
+// Process wide accounting of the buffers referenced by tracked Packets and Frames.
+// Demuxing loops wait on it when the usage exceeds the limit.
+class FFMPEG_EXPORT MemoryBudget
+{
+public:
+    void setLimit(qint64 bytes); // <= 0 means unlimited
+    [[nodiscard]] auto limit() const -> qint64;
+
+    [[nodiscard]] auto usage() const -> qint64;
+    [[nodiscard]] auto peakUsage() const -> qint64;
+    void resetPeakUsage();
+
+    [[nodiscard]] auto isExceeded() const -> bool;
+
+    void acquire(qint64 bytes);
+    void release(qint64 bytes);
+
+    // return true if the usage is below the limit, otherwise wait up to msecs for a release
+    auto waitForBudget(int msecs) -> bool;
+
+private:
+    MemoryBudget();
+    ~MemoryBudget();
+
+    class MemoryBudgetPrivate;
+    QScopedPointer<MemoryBudgetPrivate> d_ptr;
+
+    SINGLETON(MemoryBudget)
+};
+
+// Accounts a buffer outside of Packets and Frames (QByteArray, QImage) in MemoryBudget while it
+// is held, setBytes() follows its size
+class FFMPEG_EXPORT MemoryReservation
+{
+    Q_DISABLE_COPY_MOVE(MemoryReservation)
+public:
+    MemoryReservation() = default;
+    ~MemoryReservation() { reset(); }
+
+    void setBytes(qint64 bytes);
+    [[nodiscard]] auto bytes() const -> qint64 { return m_bytes; }
+    void reset() { setBytes(0); }
+
+private:
+    qint64 m_bytes = 0;
+};
+
+} // namespace Ffmpeg
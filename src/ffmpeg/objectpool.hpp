@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QMutex>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Ffmpeg {
+
+// Free list of reusable objects handed out as shared_ptr. When the last reference drops the
+// object is reset by the recycle function and kept for the next acquire(); if recycle returns
+// false or the pool is full, the object is deleted. Outstanding objects may outlive the pool.
+template<typename T>
+class ObjectPool
+{
+    Q_DISABLE_COPY_MOVE(ObjectPool)
+
+    struct State
+    {
+        QMutex mutex;
+        std::vector<std::unique_ptr<T>> objects;
+        std::size_t maxSize = 0;
+        std::function<bool(T *)> recycle;
+    };
+
+public:
+    explicit ObjectPool(std::size_t maxSize, std::function<bool(T *)> recycle)
+        : m_statePtr(std::make_shared<State>())
+    {
+        m_statePtr->maxSize = maxSize;
+        m_statePtr->recycle = std::move(recycle);
+        m_statePtr->objects.reserve(maxSize);
+    }
+
+    auto acquire() -> std::shared_ptr<T>
+    {
+        std::unique_ptr<T> object;
+        {
+            QMutexLocker locker(&m_statePtr->mutex);
+            if (!m_statePtr->objects.empty()) {
+                object = std::move(m_statePtr->objects.back());
+                m_statePtr->objects.pop_back();
+            }
+        }
+        if (!object) {
+            object = std::make_unique<T>();
+        }
+        std::weak_ptr<State> stateWeakPtr = m_statePtr;
+        return std::shared_ptr<T>(object.release(), [stateWeakPtr](T *t) {
+            std::unique_ptr<T> object(t);
+            auto statePtr = stateWeakPtr.lock();
+            if (!statePtr || !statePtr->recycle(t)) {
+                return;
+            }
+            QMutexLocker locker(&statePtr->mutex);
+            if (statePtr->objects.size() < statePtr->maxSize) {
+                statePtr->objects.push_back(std::move(object));
+            }
+        });
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        QMutexLocker locker(&m_statePtr->mutex);
+        return m_statePtr->objects.size();
+    }
+
+private:
+    std::shared_ptr<State> m_statePtr;
+};
+
+} // namespace Ffmpeg
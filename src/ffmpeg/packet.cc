@@ -1,4 +1,6 @@
 #include "packet.hpp"
+#include "memorybudget.hpp"
+#include "objectpool.hpp"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -6,6 +8,8 @@ extern "C" {
 
 namespace Ffmpeg {
 
+static constexpr auto s_maxPooledPackets = 512;
+
 struct AVPacketDeleter
 {
     void operator()(AVPacket *p) const noexcept { av_packet_free(&p); }
@@ -22,9 +26,16 @@ public:
             throw std::bad_alloc();
         }
     }
-    ~PacketPrivate() = default;
+    ~PacketPrivate() { untrackMemory(); }
+
+    void untrackMemory()
+    {
+        MemoryBudget::instance()->release(trackedBytes);
+        trackedBytes = 0;
+    }
 
     AVPacketPtr packet;
+    qint64 trackedBytes = 0;
 };
 
 Packet::Packet()
@@ -48,6 +59,7 @@ Packet &Packet::operator=(const Packet &other)
     if (this != &other) {
         AVPacket *src = other.d_ptr->packet.get();
         av_packet_unref(d_ptr->packet.get()); // 先释放旧数据
+        d_ptr->untrackMemory();
         if (src && src->buf) {
             if (av_packet_ref(d_ptr->packet.get(), src) < 0)
                 throw std::runtime_error("av_packet_ref failed");
@@ -60,6 +72,18 @@ Packet &Packet::operator=(Packet &&other) noexcept = default;
 
 Packet::~Packet() = default;
 
+auto Packet::create() -> std::shared_ptr<Packet>
+{
+    static ObjectPool<Packet> pool(s_maxPooledPackets, [](Packet *packet) {
+        if (!packet->d_ptr || !packet->d_ptr->packet) {
+            return false;
+        }
+        packet->unref();
+        return true;
+    });
+    return pool.acquire();
+}
+
 auto Packet::isValid() const -> bool
 {
     auto *p = d_ptr->packet.get();
@@ -72,9 +96,16 @@ auto Packet::isKey() const -> bool
     return p && (p->flags & AV_PKT_FLAG_KEY);
 }
 
+auto Packet::isDisposable() const -> bool
+{
+    auto *p = d_ptr->packet.get();
+    return p && (p->flags & AV_PKT_FLAG_DISPOSABLE);
+}
+
 void Packet::unref()
 {
     av_packet_unref(d_ptr->packet.get());
+    d_ptr->untrackMemory();
 }
 
 void Packet::setPts(qint64 pts)
@@ -111,6 +142,23 @@ void Packet::rescaleTs(const AVRational &src, const AVRational &dst)
     av_packet_rescale_ts(d_ptr->packet.get(), src, dst);
 }
 
+auto Packet::bufferSize() const -> qint64
+{
+    auto *p = d_ptr->packet.get();
+    if (p->buf != nullptr) {
+        return static_cast<qint64>(p->buf->size);
+    }
+    return p->size;
+}
+
+void Packet::trackMemory()
+{
+    auto size = bufferSize();
+    MemoryBudget::instance()->acquire(size - d_ptr->trackedBytes);
+    MemoryBudget::instance()->release(d_ptr->trackedBytes - size);
+    d_ptr->trackedBytes = size;
+}
+
 auto Packet::avPacket() -> AVPacket *
 {
     return d_ptr->packet.get();
@@ -22,8 +22,12 @@ public:
     Packet &operator=(Packet &&other) noexcept;
     ~Packet();
 
+    // Reuses a packet released by an earlier create() when possible
+    static auto create() -> std::shared_ptr<Packet>;
+
     auto isValid() const -> bool;
     auto isKey() const -> bool;
+    auto isDisposable() const -> bool; // no other frame references it
     void unref();
     void setPts(qint64 pts); // microseconds
     auto pts() const -> qint64;
@@ -32,6 +36,8 @@ public:
     void setStreamIndex(int index);
     auto streamIndex() const -> int;
     void rescaleTs(const AVRational &src, const AVRational &dst);
+    auto bufferSize() const -> qint64; // bytes referenced by the packet buffer
+    void trackMemory(); // account bufferSize() in MemoryBudget until unref or destruction
     auto avPacket() -> AVPacket *;
 
 private:
@@ -0,0 +1,205 @@
+#include "packetcache.hpp"
+#include "formatcontext.h"
+#include "memorybudget.hpp"
+
+#include <QDebug>
+
+#include <atomic>
+#include <deque>
+
+extern "C" {
+#include <libavcodec/packet.h>
+#include <libavformat/avformat.h>
+}
+
+namespace Ffmpeg {
+
+static constexpr qint64 s_maxCacheBytes = 256 * 1024 * 1024;
+
+class PacketCache::PacketCachePrivate
+{
+public:
+    struct Entry
+    {
+        PacketPtr packetPtr;
+        qint64 pts = 0; // microsecond
+        bool seekPoint = false;
+    };
+
+    explicit PacketCachePrivate(PacketCache *q)
+        : q_ptr(q)
+    {}
+
+    auto packetPts(const PacketPtr &packetPtr) -> qint64
+    {
+        auto *avPacket = packetPtr->avPacket();
+        auto pts = avPacket->pts == AV_NOPTS_VALUE ? avPacket->dts : avPacket->pts;
+        if (pts == AV_NOPTS_VALUE) {
+            return entries.empty() ? 0 : entries.back().pts;
+        }
+        auto *stream = formatContext->stream(avPacket->stream_index);
+        return av_rescale_q(pts, stream->time_base, AV_TIME_BASE_Q);
+    }
+
+    // index of the next seek point after the first entry, entries.size() if there is none
+    [[nodiscard]] auto secondSeekPoint() const -> size_t
+    {
+        for (size_t i = 1; i < entries.size(); ++i) {
+            if (entries[i].seekPoint) {
+                return i;
+            }
+        }
+        return entries.size();
+    }
+
+    void popFront(size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            bytes -= entries.front().packetPtr->bufferSize();
+            entries.pop_front();
+        }
+        cursor -= qMin(cursor, count);
+        reservation.setBytes(bytes);
+    }
+
+    PacketCache *q_ptr;
+
+    FormatContext *formatContext;
+    std::atomic<qint64> maxDuration = 0; // set from any thread
+    std::atomic<qint64> maxBytes = s_maxCacheBytes;
+    int keyStreamIndex = -1;
+
+    std::deque<Entry> entries;
+    size_t cursor = 0; // next entry to replay, entries.size() when live
+    qint64 bytes = 0;
+    // the cached references keep the buffers alive after the live packets are untracked
+    MemoryReservation reservation;
+};
+
+PacketCache::PacketCache(FormatContext *formatContext, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new PacketCachePrivate(this))
+{
+    d_ptr->formatContext = formatContext;
+}
+
+PacketCache::~PacketCache() = default;
+
+void PacketCache::setMaxDuration(qint64 duration)
+{
+    d_ptr->maxDuration.store(qMax(0LL, duration));
+}
+
+auto PacketCache::maxDuration() const -> qint64
+{
+    return d_ptr->maxDuration.load();
+}
+
+void PacketCache::setMaxBytes(qint64 bytes)
+{
+    d_ptr->maxBytes.store(bytes);
+}
+
+auto PacketCache::maxBytes() const -> qint64
+{
+    return d_ptr->maxBytes.load();
+}
+
+void PacketCache::setKeyStreamIndex(int index)
+{
+    clear();
+    d_ptr->keyStreamIndex = index;
+}
+
+auto PacketCache::isEnabled() const -> bool
+{
+    return d_ptr->maxDuration.load() > 0 && d_ptr->keyStreamIndex >= 0;
+}
+
+void PacketCache::append(const PacketPtr &packetPtr)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    auto seekPoint = packetPtr->streamIndex() == d_ptr->keyStreamIndex && packetPtr->isKey();
+    if (d_ptr->entries.empty() && !seekPoint) {
+        return;
+    }
+    auto cachePtr = Packet::create();
+    *cachePtr = *packetPtr;
+    auto pts = d_ptr->packetPts(cachePtr);
+    d_ptr->bytes += cachePtr->bufferSize();
+    d_ptr->reservation.setBytes(d_ptr->bytes);
+    d_ptr->entries.push_back({cachePtr, pts, seekPoint});
+    d_ptr->cursor = d_ptr->entries.size();
+}
+
+auto PacketCache::take(PacketPtr &packetPtr) -> bool
+{
+    if (d_ptr->cursor >= d_ptr->entries.size()) {
+        return false;
+    }
+    packetPtr = Packet::create();
+    *packetPtr = *d_ptr->entries[d_ptr->cursor++].packetPtr;
+    return true;
+}
+
+auto PacketCache::seek(qint64 position) -> bool
+{
+    if (!isEnabled() || d_ptr->entries.empty()) {
+        return false;
+    }
+    size_t found = d_ptr->entries.size();
+    qint64 lastKeyPts = AV_NOPTS_VALUE;
+    for (size_t i = 0; i < d_ptr->entries.size(); ++i) {
+        const auto &entry = d_ptr->entries[i];
+        if (entry.packetPtr->streamIndex() != d_ptr->keyStreamIndex) {
+            continue;
+        }
+        lastKeyPts = entry.pts;
+        if (entry.seekPoint && entry.pts <= position) {
+            found = i;
+        }
+    }
+    if (found == d_ptr->entries.size() || lastKeyPts == AV_NOPTS_VALUE || position > lastKeyPts) {
+        return false;
+    }
+    d_ptr->cursor = found;
+    return true;
+}
+
+void PacketCache::trim(qint64 position)
+{
+    if (!isEnabled()) {
+        clear();
+        return;
+    }
+    forever {
+        auto next = d_ptr->secondSeekPoint();
+        // never drop the GOP being replayed
+        if (next == d_ptr->entries.size() || next > d_ptr->cursor) {
+            break;
+        }
+        auto tooOld = d_ptr->entries[next].pts < position - d_ptr->maxDuration.load();
+        auto tooBig = d_ptr->maxBytes.load() > 0 && d_ptr->bytes > d_ptr->maxBytes.load();
+        if (!tooOld && !tooBig) {
+            break;
+        }
+        d_ptr->popFront(next);
+    }
+}
+
+void PacketCache::clear()
+{
+    d_ptr->entries.clear();
+    d_ptr->cursor = 0;
+    d_ptr->bytes = 0;
+    d_ptr->reservation.reset();
+}
+
+auto PacketCache::bytes() const -> qint64
+{
+    return d_ptr->bytes;
+}
+
+} // namespace Ffmpeg
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "packet.hpp"
+
+#include <QObject>
+
+namespace Ffmpeg {
+
+class FormatContext;
+
+// Keeps already demuxed packets around so that a seek landing inside the cached range is
+// replayed from memory instead of going back to the demuxer. Packets are cut into GOPs at the
+// keyframes of the key stream; whole GOPs are dropped once they fall behind the playhead by more
+// than maxDuration, or the cache grows beyond maxBytes.
+class PacketCache : public QObject
+{
+public:
+    explicit PacketCache(FormatContext *formatContext, QObject *parent = nullptr);
+    ~PacketCache() override;
+
+    // thread safe, the other functions belong to the demuxing thread
+    void setMaxDuration(qint64 duration); // microsecond behind the playhead, <= 0 disables
+    [[nodiscard]] auto maxDuration() const -> qint64;
+    void setMaxBytes(qint64 bytes);
+    [[nodiscard]] auto maxBytes() const -> qint64;
+
+    void setKeyStreamIndex(int index);
+    [[nodiscard]] auto isEnabled() const -> bool;
+
+    // live packet from the demuxer, a copy is cached
+    void append(const PacketPtr &packetPtr);
+    // next packet to replay after a seek(), false when the live position is reached
+    auto take(PacketPtr &packetPtr) -> bool;
+
+    // microsecond, false if the position is not inside the cached range
+    auto seek(qint64 position) -> bool;
+    // drop the GOPs that are too far behind the playhead, microsecond
+    void trim(qint64 position);
+    void clear();
+
+    [[nodiscard]] auto bytes() const -> qint64;
+
+private:
+    class PacketCachePrivate;
+    QScopedPointer<PacketCachePrivate> d_ptr;
+};
+
+} // namespace Ffmpeg
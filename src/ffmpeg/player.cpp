@@ -6,7 +6,9 @@
 #include "codeccontext.h"
 #include "formatcontext.h"
 #include "mediainfo.hpp"
+#include "memorybudget.hpp"
 #include "packet.hpp"
+#include "packetcache.hpp"
 #include "subtitledecoder.h"
 #include "videodecoder.h"
 
@@ -34,14 +36,21 @@ public:
         : q_ptr(q)
     {
         formatCtx = new FormatContext(q_ptr);
+        packetCache = new PacketCache(formatCtx, q_ptr);
 
         audioInfo = new AVContextInfo(q_ptr);
         videoInfo = new AVContextInfo(q_ptr);
         subtitleInfo = new AVContextInfo(q_ptr);
 
-        audioDecoder = new AudioDecoder(q_ptr);
-        videoDecoder = new VideoDecoder(q_ptr);
-        subtitleDecoder = new SubtitleDecoder(q_ptr);
+        clockDomain = new ClockDomain(q_ptr);
+        audioDecoder = new AudioDecoder(clockDomain, q_ptr);
+        videoDecoder = new VideoDecoder(clockDomain, q_ptr);
+        subtitleDecoder = new SubtitleDecoder(clockDomain, q_ptr);
+
+        // a newer seek makes the running one obsolete, closing aborts any blocking io
+        formatCtx->setInterruptCallback([this] {
+            return !runing.load() || (seeking.load() && seekSerial.load() != runningSeekSerial);
+        });
 
         QObject::connect(AVErrorManager::instance(),
                          &AVErrorManager::error,
@@ -72,6 +81,13 @@ public:
         isOpen = true;
         formatCtx->dumpFormat();
 
+        if (videoInfo->isIndexVaild()
+            && ((videoInfo->stream()->disposition & AV_DISPOSITION_ATTACHED_PIC) == 0)) {
+            packetCache->setKeyStreamIndex(videoInfo->index());
+        } else {
+            packetCache->setKeyStreamIndex(audioInfo->index());
+        }
+
         addPropertyChangeEvent(new DurationEvent(formatCtx->duration()));
         q_ptr->onPositionChanged(0);
 
@@ -171,7 +187,7 @@ public:
         } else {
             Q_ASSERT(false);
         }
-        Clock::master()->invalidate();
+        clockDomain->master()->invalidate();
 
         speedPtr.reset(new Utils::Speed);
         speedTimer.restart();
@@ -187,6 +203,24 @@ public:
         audioDecoder->stopDecoder();
     }
 
+    // end of file, every stage plays out what it has buffered before the decoders are stopped
+    void drainDecoder()
+    {
+        videoDecoder->setEof();
+        audioDecoder->setEof();
+        subtitleDecoder->setEof();
+
+        videoDecoder->waitDrained();
+        audioDecoder->waitDrained();
+    }
+
+    void cancelDrainDecoder()
+    {
+        videoDecoder->cancelDrain();
+        audioDecoder->cancelDrain();
+        subtitleDecoder->cancelDrain();
+    }
+
     void addSpeedChangeEvent(int size)
     {
         speedPtr->addSize(size);
@@ -205,8 +239,12 @@ public:
         while (runing) {
             processEvent();
 
-            PacketPtr packetPtr(new Packet);
-            if (!formatCtx->readFrame(packetPtr)) {
+            if (!waitMemoryBudget()) {
+                continue;
+            }
+
+            PacketPtr packetPtr;
+            if (!readPacket(packetPtr)) {
                 break;
             }
             addSpeedChangeEvent(packetPtr->avPacket()->size);
@@ -223,14 +261,50 @@ public:
                 subtitleDecoder->append(packetPtr);
             }
         }
-        while (runing && (videoDecoder->size() > 0 || audioDecoder->size() > 0)) {
-            msleep(s_waitQueueEmptyMilliseconds);
+        if (runing) {
+            drainDecoder();
         }
         stopDecoder();
         setMediaState(Stopped);
         qInfo() << "play finish";
     }
 
+    // replays the packet cache after a seek inside it, then continues with the demuxer
+    auto readPacket(PacketPtr &packetPtr) -> bool
+    {
+        if (packetCache->take(packetPtr)) {
+            return true;
+        }
+        packetPtr = Packet::create();
+        if (!formatCtx->readFrame(packetPtr)) {
+            return false;
+        }
+        packetCache->append(packetPtr);
+        packetCache->trim(position);
+        return true;
+    }
+
+    // Decoders that ran dry are always fed, otherwise the player could stall on memory held by
+    // other players.
+    [[nodiscard]] auto decoderStarving() const -> bool
+    {
+        return (audioInfo->isIndexVaild() && audioDecoder->size() == 0)
+               || (videoInfo->isIndexVaild()
+                   && ((videoInfo->stream()->disposition & AV_DISPOSITION_ATTACHED_PIC) == 0)
+                   && videoDecoder->size() == 0);
+    }
+
+    // return false if the global memory budget is still exceeded, events have to be processed
+    // before waiting again
+    auto waitMemoryBudget() const -> bool
+    {
+        auto *memoryBudget = MemoryBudget::instance();
+        if (!memoryBudget->isExceeded() || decoderStarving()) {
+            return true;
+        }
+        return memoryBudget->waitForBudget(s_waitQueueEmptyMilliseconds);
+    }
+
     auto setMediaIndex(AVContextInfo *contextInfo, int index) const -> bool
     {
         contextInfo->setIndex(index);
@@ -270,6 +344,11 @@ public:
 
     void addEvent(const EventPtr &eventPtr)
     {
+        switch (eventPtr->type()) {
+        case Event::EventType::Seek:
+        case Event::EventType::SeekRelative: seekSerial.fetch_add(1); break;
+        default: break;
+        }
         eventQueue.push_back(eventPtr);
         while (eventQueue.size() > maxEventQueueSize.load()) {
             eventQueue.take();
@@ -292,8 +371,10 @@ public:
             auto eventPtr = eventQueue.take();
             switch (eventPtr->type()) {
             case Event::EventType::Pause: processPauseEvent(eventPtr); break;
-            case Event::EventType::Seek: processSeekEvent(eventPtr); break;
-            case Event::EventType::SeekRelative: processSeekRelativeEvent(eventPtr); break;
+            case Event::EventType::Seek:
+            case Event::EventType::SeekRelative:
+                processSeekEvent(takeLatestSeekEvent(eventPtr));
+                break;
             default: break;
             }
         }
@@ -336,16 +417,43 @@ public:
             QMutexLocker locker(&mutex);
             waitCondition.wait(&mutex);
         } else {
-            Clock::master()->invalidate();
+            clockDomain->master()->invalidate();
         }
     }
 
+    [[nodiscard]] auto seekPosition(const EventPtr &eventPtr, qint64 position) const -> qint64
+    {
+        if (eventPtr->type() == Event::EventType::Seek) {
+            return dynamic_cast<SeekEvent *>(eventPtr.data())->position();
+        }
+        auto *seekRelativeEvent = dynamic_cast<SeekRelativeEvent *>(eventPtr.data());
+        position += seekRelativeEvent->relativePosition() * AV_TIME_BASE;
+        return qBound(0LL, position, q_ptr->duration());
+    }
+
+    // Consecutive seeks (e.g. dragging the slider) collapse into the newest target
+    auto takeLatestSeekEvent(const EventPtr &eventPtr) -> EventPtr
+    {
+        auto position = seekPosition(eventPtr, this->position);
+        while (!eventQueue.isEmpty()) {
+            auto nextEventPtr = eventQueue.take();
+            if (nextEventPtr->type() != Event::EventType::Seek
+                && nextEventPtr->type() != Event::EventType::SeekRelative) {
+                eventQueue.push_front(nextEventPtr);
+                break;
+            }
+            position = seekPosition(nextEventPtr, position);
+        }
+        runningSeekSerial = seekSerial.load();
+        return EventPtr(new SeekEvent(position));
+    }
+
     void processSeekEvent(const EventPtr &eventPtr)
     {
         QElapsedTimer timer;
         timer.start();
         q_ptr->blockSignals(true);
-        Clock::globalSerialRef();
+        clockDomain->serialRef();
         int count = 0;
         if (audioInfo->isIndexVaild()) {
             count++;
@@ -364,7 +472,13 @@ public:
         auto position = seekEvent->position();
         seekEvent->wait();
 
-        formatCtx->seek(position, position < this->position);
+        auto seeked = packetCache->seek(position);
+        if (!seeked) {
+            packetCache->clear();
+            seeking.store(true);
+            seeked = formatCtx->seek(position, position < this->position);
+            seeking.store(false);
+        }
         if (audioInfo->isIndexVaild()) {
             audioInfo->codecCtx()->flush();
         }
@@ -376,7 +490,11 @@ public:
         }
         q_ptr->blockSignals(false);
         this->position = position;
-        Clock::master()->invalidate();
+        clockDomain->master()->invalidate();
+        if (!seeked && seekSerial.load() != runningSeekSerial) {
+            qInfo() << "Seek cancelled by a newer seek, elapsed: " << timer.elapsed() << "ms";
+            return;
+        }
         qInfo() << "Seek To: "
                 << QTime::fromMSecsSinceStartOfDay(position / 1000).toString("hh:mm:ss.zzz")
                 << "Seeked elapsed: " << timer.elapsed() << "ms";
@@ -384,19 +502,6 @@ public:
         addPropertyChangeEvent(new SeekChangedEvent(position));
     }
 
-    void processSeekRelativeEvent(const EventPtr &eventPtr)
-    {
-        auto *seekRelativeEvent = dynamic_cast<SeekRelativeEvent *>(eventPtr.data());
-        auto relativePosition = seekRelativeEvent->relativePosition();
-        auto position = this->position + relativePosition * AV_TIME_BASE;
-        if (position < 0) {
-            position = 0;
-        } else if (position > q_ptr->duration()) {
-            position = q_ptr->duration();
-        }
-        eventQueue.push_front(EventPtr(new SeekEvent(position)));
-    }
-
     void processGpuEvent(const EventPtr &eventPtr)
     {
         auto *gpuEvent = dynamic_cast<GpuEvent *>(eventPtr.data());
@@ -465,6 +570,7 @@ public:
     {
         q_ptr->buildConnect(false);
         runing.store(false);
+        cancelDrainDecoder();
         wakePause();
         if (q_ptr->isRunning()) {
             q_ptr->quit();
@@ -478,10 +584,10 @@ public:
         formatCtx->close();
     }
 
-    static void processSpeedEvent(const EventPtr &eventPtr)
+    void processSpeedEvent(const EventPtr &eventPtr) const
     {
         auto *speedEvent = dynamic_cast<SpeedEvent *>(eventPtr.data());
-        Clock::setSpeed(speedEvent->speed());
+        clockDomain->setSpeed(speedEvent->speed());
     }
 
     void processVolumeEvent(const EventPtr &eventPtr) const
@@ -493,10 +599,12 @@ public:
     Player *q_ptr;
 
     FormatContext *formatCtx;
+    PacketCache *packetCache;
     AVContextInfo *audioInfo;
     AVContextInfo *videoInfo;
     AVContextInfo *subtitleInfo;
 
+    ClockDomain *clockDomain;
     AudioDecoder *audioDecoder;
     VideoDecoder *videoDecoder;
     SubtitleDecoder *subtitleDecoder;
@@ -506,6 +614,9 @@ public:
     QString filepath;
     std::atomic_bool isOpen = true;
     std::atomic_bool runing = true;
+    std::atomic_bool seeking = false;
+    std::atomic<quint64> seekSerial = 0; // bumped by every queued seek
+    quint64 runningSeekSerial = 0;
     bool gpuDecode = true;
     qint64 position = 0;
     std::atomic<MediaState> mediaState = MediaState::Stopped;
@@ -566,9 +677,9 @@ auto Player::isOpen() -> bool
     return d_ptr->isOpen;
 }
 
-auto Player::speed() -> double
+auto Player::speed() const -> double
 {
-    return Clock::speed();
+    return d_ptr->clockDomain->speed();
 }
 
 auto Player::isGpuDecode() -> bool
@@ -638,6 +749,90 @@ auto Player::videoRenders() -> QList<VideoRender *>
     return d_ptr->videoRenders;
 }
 
+void Player::setDisplayRefreshRate(double hz)
+{
+    d_ptr->videoDecoder->setDisplayRefreshRate(hz);
+}
+
+auto Player::displayRefreshRate() const -> double
+{
+    return d_ptr->videoDecoder->displayRefreshRate();
+}
+
+auto Player::presentationError() const -> qint64
+{
+    return d_ptr->videoDecoder->presentationError();
+}
+
+void Player::setMaxBufferDuration(qint64 duration)
+{
+    d_ptr->audioDecoder->setMaxBufferDuration(duration);
+    d_ptr->videoDecoder->setMaxBufferDuration(duration);
+    d_ptr->subtitleDecoder->setMaxBufferDuration(duration);
+}
+
+auto Player::maxBufferDuration() const -> qint64
+{
+    // the queue keeps unlimited as the largest value
+    auto duration = d_ptr->videoDecoder->maxBufferDuration();
+    return duration == std::numeric_limits<qint64>::max() ? 0 : duration;
+}
+
+void Player::setMaxBufferBytes(qint64 bytes)
+{
+    d_ptr->audioDecoder->setMaxBufferBytes(bytes);
+    d_ptr->videoDecoder->setMaxBufferBytes(bytes);
+    d_ptr->subtitleDecoder->setMaxBufferBytes(bytes);
+}
+
+auto Player::maxBufferBytes() const -> qint64
+{
+    auto bytes = d_ptr->videoDecoder->maxBufferBytes();
+    return bytes == std::numeric_limits<qint64>::max() ? 0 : bytes;
+}
+
+void Player::setPacketCacheDuration(qint64 duration)
+{
+    d_ptr->packetCache->setMaxDuration(duration);
+}
+
+auto Player::packetCacheDuration() const -> qint64
+{
+    return d_ptr->packetCache->maxDuration();
+}
+
+void Player::setDecodeThreadMode(AVContextInfo::DecodeThreadMode mode)
+{
+    d_ptr->videoInfo->setDecodeThreadMode(mode);
+}
+
+auto Player::decodeThreadMode() const -> AVContextInfo::DecodeThreadMode
+{
+    return d_ptr->videoInfo->decodeThreadMode();
+}
+
+void Player::setDecodeThreadConfig(const AVContextInfo::DecodeThreadConfig &config)
+{
+    d_ptr->videoInfo->setDecodeThreadConfig(config);
+}
+
+auto Player::decodeThreadConfig() const -> AVContextInfo::DecodeThreadConfig
+{
+    return d_ptr->videoInfo->decodeThreadConfig();
+}
+
+void Player::setSharedDecoderPool(bool shared)
+{
+    d_ptr->audioDecoder->setPooled(shared);
+    d_ptr->videoDecoder->setPooled(shared);
+    d_ptr->subtitleDecoder->setPooled(shared);
+}
+
+auto Player::sharedDecoderPool() const -> bool
+{
+    return d_ptr->videoDecoder->isPooled();
+}
+
 void Player::setPropertyEventQueueMaxSize(size_t size)
 {
     d_ptr->maxPropertyEventQueueSize.store(size);
@@ -1,6 +1,7 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
+#include "avcontextinfo.h"
 #include "mediainfo.hpp"
 
 #include <ffmpeg/event/event.hpp>
@@ -20,7 +21,7 @@ public:
 
     [[nodiscard]] auto filePath() const -> QString &;
     auto isOpen() -> bool;
-    static auto speed() -> double;
+    [[nodiscard]] auto speed() const -> double;
     auto isGpuDecode() -> bool;
     auto mediaState() -> MediaState;
 
@@ -38,6 +39,39 @@ public:
     void setVideoRenders(const QList<VideoRender *> &videoRenders);
     auto videoRenders() -> QList<VideoRender *>;
 
+    // Refresh rate of the screen showing the renders, frames are paced on its grid; <= 0 unknown.
+    void setDisplayRefreshRate(double hz);
+    [[nodiscard]] auto displayRefreshRate() const -> double;
+    // presented minus targeted time of the last video frame
+    [[nodiscard]] auto presentationError() const -> qint64; // microsecond
+
+    // Per decoder stage read-ahead, packets and decoded frames are queued until either limit is
+    // reached; <= 0 means unlimited, reported as 0.
+    void setMaxBufferDuration(qint64 duration); // microsecond
+    [[nodiscard]] auto maxBufferDuration() const -> qint64;
+    void setMaxBufferBytes(qint64 bytes);
+    [[nodiscard]] auto maxBufferBytes() const -> qint64;
+
+    // Already demuxed packets kept behind the playhead, seeks inside them skip the demuxer;
+    // 0 disables the cache.
+    void setPacketCacheDuration(qint64 duration); // microsecond
+    [[nodiscard]] auto packetCacheDuration() const -> qint64;
+
+    // Video decoder threading, takes effect on the next open; audio and subtitles always decode
+    // on one thread in auto mode.
+    void setDecodeThreadMode(AVContextInfo::DecodeThreadMode mode);
+    [[nodiscard]] auto decodeThreadMode() const -> AVContextInfo::DecodeThreadMode;
+    void setDecodeThreadConfig(const AVContextInfo::DecodeThreadConfig &config);
+    // chosen for the current video stream
+    [[nodiscard]] auto decodeThreadConfig() const -> AVContextInfo::DecodeThreadConfig;
+
+    // Decode on the process wide DecoderScheduler pool instead of three own threads, meant for
+    // many players per process; takes effect on the next open. Only the packet decoder stages
+    // are pooled, each player still owns its demuxer, video/audio/subtitle display and audio
+    // output threads, and a slice stays on the worker that picked it up (no work stealing).
+    void setSharedDecoderPool(bool shared);
+    [[nodiscard]] auto sharedDecoderPool() const -> bool;
+
     void setPropertyEventQueueMaxSize(size_t size);
     [[nodiscard]] auto propertEventyQueueMaxSize() const -> size_t;
     [[nodiscard]] auto propertyChangeEventSize() const -> size_t;
@@ -5,6 +5,7 @@
 #include "formatcontext.h"
 #include "frame.hpp"
 #include "packet.hpp"
+#include "thumbnailcache.hpp"
 #include "transcoder.hpp"
 #include "videoframeconverter.hpp"
 
@@ -16,12 +17,15 @@ extern "C" {
 
 namespace Ffmpeg {
 
+// the box of the transcoder's preview strip in the thumbnail cache
+static const QSize s_previewCountSize = {640, 360};
+
 static auto getKeyFrame(FormatContext *formatContext,
                         AVContextInfo *videoInfo,
                         qint64 timestamp,
                         FramePtr &outPtr) -> bool
 {
-    PacketPtr packetPtr(new Packet);
+    auto packetPtr = Packet::create();
     if (!formatContext->readFrame(packetPtr)) {
         return false;
     }
@@ -45,6 +49,174 @@ static auto getKeyFrame(FormatContext *formatContext,
     return true;
 }
 
+// scaled into size keeping the aspect ratio, a deep copy
+static auto thumbnailImage(const FramePtr &framePtr, const QSize &size) -> QImage
+{
+    auto dstSize = QSize(framePtr->avFrame()->width, framePtr->avFrame()->height);
+    dstSize.scale(size, Qt::KeepAspectRatio);
+
+    auto dst_pix_fmt = AV_PIX_FMT_RGB32;
+    QScopedPointer<VideoFrameConverter> frameConverterPtr(
+        new VideoFrameConverter(framePtr, dstSize, dst_pix_fmt));
+    FramePtr frameRgbPtr(new Frame);
+    frameRgbPtr->imageAlloc(dstSize, dst_pix_fmt);
+    //frameConverterPtr->flush(framePtr.data(), dstSize);
+    frameConverterPtr->scale(framePtr, frameRgbPtr);
+    return frameRgbPtr->toImage().copy();
+}
+
+class PreviewSession::PreviewSessionPrivate
+{
+public:
+    explicit PreviewSessionPrivate(PreviewSession *q)
+        : q_ptr(q)
+    {}
+
+    auto open() -> bool
+    {
+        if (isOpen) {
+            return true;
+        }
+        formatCtxPtr.reset(new FormatContext);
+        formatCtxPtr->setInterruptCallback([this] { return interrupted(); });
+        if (!formatCtxPtr->openFilePath(filepath) || !formatCtxPtr->findStream()) {
+            return false;
+        }
+        if (videoIndex >= formatCtxPtr->streams()) {
+            return false;
+        }
+        if (!openDecoder(decoderSize)) {
+            return false;
+        }
+        formatCtxPtr->discardStreamExcluded({videoIndex});
+        chapters = formatCtxPtr->mediaInfo().chapters;
+        isOpen = true;
+        return true;
+    }
+
+    // lowres decoders pick their resolution by size, a larger thumbnail needs a new decoder
+    auto openDecoder(const QSize &size) -> bool
+    {
+        decoderSize = size;
+        videoInfoPtr.reset(new AVContextInfo);
+        videoInfoPtr->setIndex(videoIndex);
+        videoInfoPtr->setStream(formatCtxPtr->stream(videoIndex));
+        if (!videoInfoPtr->initDecoder(formatCtxPtr->guessFrameRate(videoIndex))) {
+            return false;
+        }
+        videoInfoPtr->setThumbnailDecode(true, decoderSize);
+        return videoInfoPtr->openCodec(); // 软解
+    }
+
+    // a failed io leaves the demuxer in an unknown state, the next request opens it again
+    void close()
+    {
+        isOpen = false;
+        videoInfoPtr.reset();
+        formatCtxPtr.reset();
+    }
+
+    [[nodiscard]] auto interrupted() const -> bool
+    {
+        return aborted.load() || (isCanceled && isCanceled());
+    }
+
+    PreviewSession *q_ptr;
+
+    QString filepath;
+    int videoIndex = -1;
+
+    mutable QMutex mutex;
+    QScopedPointer<FormatContext> formatCtxPtr;
+    QScopedPointer<AVContextInfo> videoInfoPtr;
+    QSize decoderSize;
+    Chapters chapters;
+    bool isOpen = false;
+    std::function<bool()> isCanceled;
+    std::atomic_bool aborted = false;
+};
+
+PreviewSession::PreviewSession(const QString &filepath, int videoIndex)
+    : d_ptr(new PreviewSessionPrivate(this))
+{
+    d_ptr->filepath = filepath;
+    d_ptr->videoIndex = videoIndex;
+}
+
+PreviewSession::~PreviewSession()
+{
+    abort();
+}
+
+auto PreviewSession::filepath() const -> QString
+{
+    return d_ptr->filepath;
+}
+
+auto PreviewSession::videoIndex() const -> int
+{
+    return d_ptr->videoIndex;
+}
+
+auto PreviewSession::keyFrame(qint64 timestamp,
+                              const QSize &size,
+                              const std::function<bool()> &isCanceled,
+                              FramePtr &framePtr) -> bool
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->isCanceled = isCanceled;
+    auto clearCanceled = qScopeGuard([this] { d_ptr->isCanceled = nullptr; });
+    if (!d_ptr->isOpen) {
+        d_ptr->decoderSize = size;
+    }
+    if (d_ptr->interrupted() || !d_ptr->open()) {
+        d_ptr->close();
+        return false;
+    }
+    if (size.width() > d_ptr->decoderSize.width() || size.height() > d_ptr->decoderSize.height()) {
+        if (!d_ptr->openDecoder(size.expandedTo(d_ptr->decoderSize))) {
+            d_ptr->close();
+            return false;
+        }
+    }
+
+    auto *formatContext = d_ptr->formatCtxPtr.data();
+    auto *videoInfo = d_ptr->videoInfoPtr.data();
+    formatContext->seekKeyFrame(d_ptr->videoIndex, timestamp, true);
+    videoInfo->codecCtx()->flush();
+    while (nullptr == framePtr) {
+        if (d_ptr->interrupted()) {
+            return false;
+        }
+        if (!getKeyFrame(formatContext, videoInfo, timestamp, framePtr)) {
+            // past the last key frame the demuxer is still usable
+            auto *pb = formatContext->avFormatContext()->pb;
+            if (!d_ptr->interrupted() && (pb == nullptr || avio_feof(pb) == 0)) {
+                d_ptr->close();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+auto PreviewSession::chapterText(qint64 timestamp) const -> QString
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    auto timeStamp = timestamp / AV_TIME_BASE;
+    for (const auto &chapter : std::as_const(d_ptr->chapters)) {
+        if (chapter.startTime <= timeStamp && chapter.endTime >= timeStamp) {
+            return chapter.metadatas.value("title");
+        }
+    }
+    return {};
+}
+
+void PreviewSession::abort()
+{
+    d_ptr->aborted.store(true);
+}
+
 class PreviewOneTask::PreviewOneTaskPrivate
 {
 public:
@@ -52,79 +224,71 @@ public:
         : q_ptr(q)
     {}
 
-    void loop(FormatContext *formatContext, AVContextInfo *videoInfo) const
+    [[nodiscard]] auto isCanceled() const -> bool
     {
-        while (!videoPreviewWidgetPtr.isNull() && taskId == videoPreviewWidgetPtr->currentTaskId()) {
+        return !runing.load() || videoPreviewWidgetPtr.isNull()
+               || taskId != videoPreviewWidgetPtr->currentTaskId();
+    }
+
+    void preview() const
+    {
+        if (isCanceled()) {
+            return;
+        }
+        auto devicePixelRatio = videoPreviewWidgetPtr->devicePixelRatio();
+        auto size = videoPreviewWidgetPtr->size() * devicePixelRatio;
+
+        auto *thumbnailCache = ThumbnailCache::instance();
+        auto filepath = sessionPtr->filepath();
+        auto videoIndex = sessionPtr->videoIndex();
+        auto position = thumbnailCache->quantize(timestamp);
+        Thumbnail thumbnail;
+        if (!thumbnailCache->find(filepath, videoIndex, position, size, thumbnail)) {
             FramePtr framePtr;
-            while (nullptr == framePtr) {
-                if (!getKeyFrame(formatContext, videoInfo, timestamp, framePtr)) {
+            auto ok = sessionPtr->keyFrame(
+                position,
+                size,
+                [this] { return isCanceled(); },
+                framePtr);
+            if (!ok) {
+                if (!isCanceled()) {
                     qWarning() << "can't get key frame";
-                    if (!videoPreviewWidgetPtr.isNull()) {
-                        videoPreviewWidgetPtr->setDisplayText(
-                            AVErrorManager::instance()->lastErrorString());
-                    }
-                    return;
+                    videoPreviewWidgetPtr->setDisplayText(
+                        AVErrorManager::instance()->lastErrorString());
                 }
-            }
-            auto dstSize = QSize(framePtr->avFrame()->width, framePtr->avFrame()->height);
-            if (videoPreviewWidgetPtr.isNull()) {
                 return;
             }
-            dstSize.scale(videoPreviewWidgetPtr->size() * videoPreviewWidgetPtr->devicePixelRatio(),
-                          Qt::KeepAspectRatio);
-
-            auto dst_pix_fmt = AV_PIX_FMT_RGB32;
-            QScopedPointer<VideoFrameConverter> frameConverterPtr(
-                new VideoFrameConverter(framePtr, dstSize, dst_pix_fmt));
-            FramePtr frameRgbPtr(new Frame);
-            frameRgbPtr->imageAlloc(dstSize, dst_pix_fmt);
-            //frameConverterPtr->flush(framePtr.data(), dstSize);
-            frameConverterPtr->scale(framePtr, frameRgbPtr);
-            auto image = frameRgbPtr->toImage();
-            auto chapterText = getChapterText(formatContext);
-            if (!videoPreviewWidgetPtr.isNull()
-                && taskId == videoPreviewWidgetPtr->currentTaskId()) {
-                image.setDevicePixelRatio(videoPreviewWidgetPtr->devicePixelRatio());
-                videoPreviewWidgetPtr->setDisplayImage(frameRgbPtr,
-                                                       image,
-                                                       framePtr->pts(),
-                                                       chapterText);
-            }
-            return;
+            thumbnail.image = thumbnailImage(framePtr, size);
+            thumbnail.pts = framePtr->pts();
+            thumbnail.chapterText = sessionPtr->chapterText(position);
+            thumbnailCache->insert(filepath, videoIndex, position, size, thumbnail);
         }
-    }
-
-    auto getChapterText(FormatContext *formatContext) const -> QString
-    {
-        auto chapters = formatContext->mediaInfo().chapters;
-        auto timeStamp = timestamp / AV_TIME_BASE;
-        for (const auto &chapter : std::as_const(chapters)) {
-            if (chapter.startTime <= timeStamp && chapter.endTime >= timeStamp) {
-                return chapter.metadatas.value("title");
-            }
+        if (!isCanceled()) {
+            auto image = thumbnail.image;
+            image.setDevicePixelRatio(devicePixelRatio);
+            videoPreviewWidgetPtr->setDisplayImage({},
+                                                   image,
+                                                   thumbnail.pts,
+                                                   thumbnail.chapterText);
         }
-        return {};
     }
 
     PreviewOneTask *q_ptr;
 
-    QString filepath;
-    int videoIndex;
+    PreviewSessionPtr sessionPtr;
     qint64 timestamp;
     int taskId = 0;
     QPointer<VideoPreviewWidget> videoPreviewWidgetPtr;
     std::atomic_bool runing = true;
 };
 
-PreviewOneTask::PreviewOneTask(const QString &filepath,
-                               int videoIndex,
+PreviewOneTask::PreviewOneTask(const PreviewSessionPtr &sessionPtr,
                                qint64 timestamp,
                                int taskId,
                                VideoPreviewWidget *videoPreviewWidget)
     : d_ptr(new PreviewOneTaskPrivate(this))
 {
-    d_ptr->filepath = filepath;
-    d_ptr->videoIndex = videoIndex;
+    d_ptr->sessionPtr = sessionPtr;
     d_ptr->timestamp = timestamp;
     d_ptr->taskId = taskId;
     d_ptr->videoPreviewWidgetPtr = videoPreviewWidget;
@@ -139,23 +303,7 @@ PreviewOneTask::~PreviewOneTask()
 
 void PreviewOneTask::run()
 {
-    QScopedPointer<FormatContext> formatCtxPtr(new FormatContext);
-    if (!formatCtxPtr->openFilePath(d_ptr->filepath) || !formatCtxPtr->findStream()) {
-        return;
-    }
-
-    QScopedPointer<AVContextInfo> videoInfoPtr(new AVContextInfo);
-    videoInfoPtr->setIndex(d_ptr->videoIndex);
-    videoInfoPtr->setStream(formatCtxPtr->stream(d_ptr->videoIndex));
-    if (!videoInfoPtr->initDecoder(formatCtxPtr->guessFrameRate(d_ptr->videoIndex))) {
-        return;
-    }
-    videoInfoPtr->openCodec(); // 软解
-    formatCtxPtr->seek(d_ptr->timestamp);
-    videoInfoPtr->codecCtx()->flush();
-    formatCtxPtr->discardStreamExcluded({d_ptr->videoIndex});
-
-    d_ptr->loop(formatCtxPtr.data(), videoInfoPtr.data());
+    d_ptr->preview();
 }
 
 class PreviewCountTask::PreviewCountTaskPrivate
@@ -165,43 +313,137 @@ public:
         : q_ptr(q)
     {}
 
-    void loop(FormatContext *formatContext, AVContextInfo *videoInfo) const
+    [[nodiscard]] auto isCanceled() const -> bool
+    {
+        return !runing.load() || transcoderPtr.isNull();
+    }
+
+    auto openDecoder(FormatContext *formatContext, AVContextInfo *videoInfo) const -> bool
+    {
+        formatContext->setInterruptCallback([this] { return isCanceled(); });
+        if (!formatContext->openFilePath(filepath) || !formatContext->findStream()) {
+            return false;
+        }
+        videoInfo->setIndex(videoIndex);
+        videoInfo->setStream(formatContext->stream(videoIndex));
+        if (!videoInfo->initDecoder(formatContext->guessFrameRate(videoIndex))) {
+            return false;
+        }
+        videoInfo->setThumbnailDecode(true, s_previewCountSize);
+        // 软解: lowres applies, and one worker per core needs no hardware device session each
+        videoInfo->openCodec();
+        formatContext->discardStreamExcluded({videoIndex});
+        return true;
+    }
+
+    void setFrame(int index, const FramePtr &framePtr)
     {
-        auto step = formatContext->duration() / count;
+        {
+            QMutexLocker locker(&mutex);
+            framePtrs[index] = framePtr;
+        }
+        if (!transcoderPtr.isNull()) {
+            transcoderPtr->setPreviewFrame(index, count, framePtr);
+        }
+    }
 
-        FramePtrList framePtrs;
-        for (int i = 0; i < count; ++i) {
-            if (!runing.load() || transcoderPtr.isNull()) {
+    // one worker, the previews [begin, end) in order on its own demuxer and decoder, opened on
+    // the first thumbnail cache miss
+    void previewRange(int begin, int end)
+    {
+        auto *thumbnailCache = ThumbnailCache::instance();
+        QScopedPointer<FormatContext> formatCtxPtr;
+        QScopedPointer<AVContextInfo> videoInfoPtr;
+        for (int i = begin; i < end; ++i) {
+            if (isCanceled()) {
                 return;
             }
 
             auto timestamp = i * step;
+            Thumbnail thumbnail;
+            auto found = thumbnailCache->find(filepath,
+                                              videoIndex,
+                                              timestamp,
+                                              s_previewCountSize,
+                                              thumbnail);
+            if (found) {
+                FramePtr framePtr(Frame::fromQImage(thumbnail.image));
+                if (nullptr != framePtr) {
+                    framePtr->setPts(thumbnail.pts);
+                    setFrame(i, framePtr);
+                    continue;
+                }
+            }
+            if (formatCtxPtr.isNull()) {
+                formatCtxPtr.reset(new FormatContext);
+                videoInfoPtr.reset(new AVContextInfo);
+                if (!openDecoder(formatCtxPtr.data(), videoInfoPtr.data())) {
+                    return;
+                }
+            }
+            auto *formatContext = formatCtxPtr.data();
+            auto *videoInfo = videoInfoPtr.data();
             if (i == 0) {
                 formatContext->seekFirstFrame();
             } else {
-                formatContext->seek(timestamp);
+                formatContext->seekKeyFrame(videoIndex, timestamp, true);
             }
             videoInfo->codecCtx()->flush();
             FramePtr framePtr;
             while (nullptr == framePtr) {
+                if (isCanceled()) {
+                    return;
+                }
                 if (!getKeyFrame(formatContext, videoInfo, timestamp, framePtr)) {
                     qWarning() << "can't get key frame";
                     return;
                 }
             }
-            framePtrs.push_back(framePtr);
+            thumbnail.image = thumbnailImage(framePtr, s_previewCountSize);
+            thumbnail.pts = framePtr->pts();
+            thumbnailCache->insert(filepath, videoIndex, timestamp, s_previewCountSize, thumbnail);
+            setFrame(i, framePtr);
         }
-        if (!transcoderPtr.isNull()) {
-            transcoderPtr->setPreviewFrames(framePtrs);
+    }
+
+    void generate()
+    {
+        framePtrs.assign(count, nullptr);
+        // a thumbnail decoder runs on one thread, see AVContextInfo::setThumbnailDecode()
+        auto workerCount = qBound(1, QThread::idealThreadCount(), count);
+        QThreadPool pool;
+        pool.setMaxThreadCount(workerCount);
+        for (int i = 0; i < workerCount; ++i) {
+            auto begin = count * i / workerCount;
+            auto end = count * (i + 1) / workerCount;
+            pool.start([this, begin, end] { previewRange(begin, end); });
         }
+        pool.waitForDone();
+
+        ThumbnailCache::instance()->sync();
+        if (isCanceled()) {
+            return;
+        }
+        FramePtrList result;
+        for (const auto &framePtr : std::as_const(framePtrs)) {
+            if (nullptr != framePtr) {
+                result.push_back(framePtr);
+            }
+        }
+        transcoderPtr->setPreviewFrames(result);
     }
 
     PreviewCountTask *q_ptr;
 
     QString filepath;
     int count;
+    int videoIndex = -1;
+    qint64 step = 0; // microsecond
     QPointer<Transcoder> transcoderPtr;
     std::atomic_bool runing = true;
+
+    QMutex mutex;
+    FramePtrList framePtrs; // by index, null until decoded
 };
 
 PreviewCountTask::PreviewCountTask(const QString &filepath, int count, Transcoder *transcoder)
@@ -221,25 +463,23 @@ PreviewCountTask::~PreviewCountTask()
 
 void PreviewCountTask::run()
 {
-    QScopedPointer<FormatContext> formatCtxPtr(new FormatContext);
-    if (!formatCtxPtr->openFilePath(d_ptr->filepath) || !formatCtxPtr->findStream()) {
-        return;
-    }
-
-    auto videoIndex = formatCtxPtr->findBestStreamIndex(AVMEDIA_TYPE_VIDEO);
-    if (videoIndex < 0) {
-        qWarning() << "can't find video stream";
+    if (d_ptr->count <= 0) {
         return;
     }
-    QScopedPointer<AVContextInfo> videoInfoPtr(new AVContextInfo);
-    videoInfoPtr->setIndex(videoIndex);
-    videoInfoPtr->setStream(formatCtxPtr->stream(videoIndex));
-    if (!videoInfoPtr->initDecoder(formatCtxPtr->guessFrameRate(videoIndex))) {
-        return;
+    {
+        // probe only, each worker opens the file on its own
+        QScopedPointer<FormatContext> formatCtxPtr(new FormatContext);
+        if (!formatCtxPtr->openFilePath(d_ptr->filepath) || !formatCtxPtr->findStream()) {
+            return;
+        }
+        d_ptr->videoIndex = formatCtxPtr->findBestStreamIndex(AVMEDIA_TYPE_VIDEO);
+        if (d_ptr->videoIndex < 0) {
+            qWarning() << "can't find video stream";
+            return;
+        }
+        d_ptr->step = formatCtxPtr->duration() / d_ptr->count;
     }
-    videoInfoPtr->openCodec(AVContextInfo::GpuDecode);
-    formatCtxPtr->discardStreamExcluded({videoIndex});
-    d_ptr->loop(formatCtxPtr.data(), videoInfoPtr.data());
+    d_ptr->generate();
 }
 
 } // namespace Ffmpeg
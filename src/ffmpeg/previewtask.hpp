@@ -1,16 +1,49 @@
 #pragma once
 
+#include "frame.hpp"
+
 #include <QRunnable>
 #include <QtCore>
 
+#include <functional>
+
 namespace Ffmpeg {
 
+// The demuxer and the video decoder of one file, kept open between the hover previews, so a
+// preview only costs a seek, a flush and one key frame decode instead of an open and a probe
+class PreviewSession
+{
+public:
+    explicit PreviewSession(const QString &filepath, int videoIndex);
+    ~PreviewSession();
+
+    [[nodiscard]] auto filepath() const -> QString;
+    [[nodiscard]] auto videoIndex() const -> int;
+
+    // The first key frame at or after timestamp (microsecond); opens the file on first use.
+    // Decoded in the thumbnail mode at a resolution that still covers size.
+    // isCanceled is polled while reading and aborts the blocking io of a stale request
+    auto keyFrame(qint64 timestamp,
+                  const QSize &size,
+                  const std::function<bool()> &isCanceled,
+                  FramePtr &framePtr) -> bool;
+    [[nodiscard]] auto chapterText(qint64 timestamp) const -> QString;
+
+    // aborts the io of the running request, for a session about to be dropped
+    void abort();
+
+private:
+    class PreviewSessionPrivate;
+    QScopedPointer<PreviewSessionPrivate> d_ptr;
+};
+
+using PreviewSessionPtr = QSharedPointer<PreviewSession>;
+
 class VideoPreviewWidget;
 class PreviewOneTask : public QRunnable
 {
 public:
-    explicit PreviewOneTask(const QString &filepath,
-                            int videoIndex,
+    explicit PreviewOneTask(const PreviewSessionPtr &sessionPtr,
                             qint64 timestamp,
                             int taskId,
                             VideoPreviewWidget *videoPreviewWidget);
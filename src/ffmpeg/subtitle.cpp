@@ -1,4 +1,5 @@
 #include "subtitle.h"
+#include "memorybudget.hpp"
 
 #include <subtitle/ass.hpp>
 
@@ -55,6 +56,7 @@ public:
             }
             av_freep(&pixels[0]);
         }
+        imageReservation.setBytes(image.sizeInBytes());
         pts = pts + static_cast<qint64>(subtitle.start_display_time) * 1000;
         duration = subtitle.end_display_time - subtitle.start_display_time;
         duration = duration * 1000;
@@ -96,6 +98,7 @@ public:
     QByteArrayList texts;
     AssDataInfoList assList;
     QImage image;
+    MemoryReservation imageReservation;
 };
 
 Subtitle::Subtitle(QObject *parent)
@@ -210,6 +213,7 @@ auto Subtitle::generateImage() const -> QImage
         painter.drawImage(rect, image);
     }
 
+    d_ptr->imageReservation.setBytes(d_ptr->image.sizeInBytes());
     return d_ptr->image;
 }
 
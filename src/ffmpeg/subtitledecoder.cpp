@@ -3,8 +3,6 @@
 #include "subtitle.h"
 #include "subtitledisplay.hpp"
 
-#include <event/seekevent.hpp>
-
 extern "C" {
 #include <libavcodec/packet.h>
 }
@@ -14,27 +12,25 @@ namespace Ffmpeg {
 class SubtitleDecoder::SubtitleDecoderPrivate
 {
 public:
-    explicit SubtitleDecoderPrivate(SubtitleDecoder *q)
+    explicit SubtitleDecoderPrivate(SubtitleDecoder *q, ClockDomain *clockDomain)
         : q_ptr(q)
     {
-        decoderSubtitleFrame = new SubtitleDisplay(q_ptr);
+        decoderSubtitleFrame = new SubtitleDisplay(clockDomain, q_ptr);
     }
 
-    void processEvent() const
+    auto decode(const PacketPtr &packetPtr) const -> SubtitlePtr
     {
-        while (q_ptr->m_runing.load() && !q_ptr->m_eventQueue.isEmpty()) {
-            auto eventPtr = q_ptr->m_eventQueue.take();
-            switch (eventPtr->type()) {
-            case Event::EventType::Pause: decoderSubtitleFrame->addEvent(eventPtr); break;
-            case Event::EventType::Seek: {
-                auto *seekEvent = static_cast<SeekEvent *>(eventPtr.data());
-                seekEvent->countDown();
-                q_ptr->clear();
-                decoderSubtitleFrame->addEvent(eventPtr);
-            } break;
-            default: break;
-            }
+        //qDebug() << "packet ass :" << QString::fromUtf8(packetPtr->avPacket()->data);
+        SubtitlePtr subtitlePtr(new Subtitle);
+        if (!q_ptr->m_contextInfo->decodeSubtitle2(subtitlePtr, packetPtr)) {
+            return {};
         }
+
+        calculatePts(packetPtr, q_ptr->m_contextInfo);
+        subtitlePtr->setDefault(packetPtr->pts(),
+                                packetPtr->duration(),
+                                reinterpret_cast<const char *>(packetPtr->avPacket()->data));
+        return subtitlePtr;
     }
 
     SubtitleDecoder *q_ptr;
@@ -42,10 +38,12 @@ public:
     SubtitleDisplay *decoderSubtitleFrame;
 };
 
-SubtitleDecoder::SubtitleDecoder(QObject *parent)
-    : Decoder<PacketPtr>(parent)
-    , d_ptr(new SubtitleDecoderPrivate(this))
-{}
+SubtitleDecoder::SubtitleDecoder(ClockDomain *clockDomain, QObject *parent)
+    : PacketDecoder<SubtitlePtr>(parent)
+    , d_ptr(new SubtitleDecoderPrivate(this, clockDomain))
+{
+    m_nextStage = d_ptr->decoderSubtitleFrame;
+}
 
 SubtitleDecoder::~SubtitleDecoder()
 {
@@ -62,34 +60,17 @@ void SubtitleDecoder::setVideoRenders(const QList<VideoRender *> &videoRenders)
     d_ptr->decoderSubtitleFrame->setVideoRenders(videoRenders);
 }
 
-void SubtitleDecoder::runDecoder()
+auto SubtitleDecoder::decodePacket(const PacketPtr &packetPtr) -> OutputList
 {
-    d_ptr->decoderSubtitleFrame->startDecoder(m_formatContext, m_contextInfo);
-
-    while (m_runing) {
-        d_ptr->processEvent();
-
-        auto packetPtr(m_queue.take());
-        if (nullptr == packetPtr) {
-            continue;
-        }
-        //qDebug() << "packet ass :" << QString::fromUtf8(packetPtr->avPacket()->data);
-        SubtitlePtr subtitlePtr(new Subtitle);
-        if (!m_contextInfo->decodeSubtitle2(subtitlePtr, packetPtr)) {
-            continue;
-        }
-
-        calculatePts(packetPtr, m_contextInfo);
-        subtitlePtr->setDefault(packetPtr->pts(),
-                                packetPtr->duration(),
-                                reinterpret_cast<const char *>(packetPtr->avPacket()->data));
-
-        d_ptr->decoderSubtitleFrame->append(subtitlePtr);
+    // nothing is delayed in the subtitle decoders
+    if (!packetPtr->isValid()) {
+        return {};
     }
-    while (m_runing && d_ptr->decoderSubtitleFrame->size() != 0) {
-        msleep(s_waitQueueEmptyMilliseconds);
+    auto subtitlePtr = d_ptr->decode(packetPtr);
+    if (subtitlePtr.isNull()) {
+        return {};
     }
-    d_ptr->decoderSubtitleFrame->stopDecoder();
+    return {subtitlePtr};
 }
 
 } // namespace Ffmpeg
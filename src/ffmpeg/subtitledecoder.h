@@ -2,15 +2,17 @@
 
 #include "decoder.h"
 #include "packet.hpp"
+#include "subtitle.h"
 
 namespace Ffmpeg {
 
+class ClockDomain;
 class VideoRender;
 
-class SubtitleDecoder : public Decoder<PacketPtr>
+class SubtitleDecoder : public PacketDecoder<SubtitlePtr>
 {
 public:
-    explicit SubtitleDecoder(QObject *parent = nullptr);
+    explicit SubtitleDecoder(ClockDomain *clockDomain, QObject *parent = nullptr);
     ~SubtitleDecoder() override;
 
     void setVideoResolutionRatio(const QSize &size);
@@ -18,7 +20,7 @@ public:
     void setVideoRenders(const QList<VideoRender *> &videoRenders);
 
 protected:
-    void runDecoder() override;
+    auto decodePacket(const PacketPtr &packetPtr) -> OutputList override;
 
 private:
     class SubtitleDecoderPrivate;
@@ -22,10 +22,10 @@ namespace Ffmpeg {
 class SubtitleDisplay::SubtitleDisplayPrivate
 {
 public:
-    explicit SubtitleDisplayPrivate(SubtitleDisplay *q)
+    explicit SubtitleDisplayPrivate(SubtitleDisplay *q, ClockDomain *clockDomain)
         : q_ptr(q)
     {
-        clock = new Clock(q);
+        clock = new Clock(clockDomain, q);
     }
 
     void renderFrame(const QSharedPointer<Subtitle> &subtitlePtr)
@@ -69,9 +69,9 @@ public:
     QList<VideoRender *> videoRenders = {};
 };
 
-SubtitleDisplay::SubtitleDisplay(QObject *parent)
+SubtitleDisplay::SubtitleDisplay(ClockDomain *clockDomain, QObject *parent)
     : Decoder<SubtitlePtr>(parent)
-    , d_ptr(new SubtitleDisplayPrivate(this))
+    , d_ptr(new SubtitleDisplayPrivate(this, clockDomain))
 {}
 
 SubtitleDisplay::~SubtitleDisplay()
@@ -109,6 +109,9 @@ void SubtitleDisplay::runDecoder()
 
         auto subtitlePtr(m_queue.take());
         if (subtitlePtr.isNull()) {
+            if (isEofReached()) {
+                break;
+            }
             continue;
         }
         if (!firstFrame) {
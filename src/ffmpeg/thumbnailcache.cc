@@ -0,0 +1,548 @@
+#include "thumbnailcache.hpp"
+
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QPainter>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace Ffmpeg {
+
+static constexpr qint64 s_defaultMaxBytes = 64 * 1024 * 1024;
+static constexpr qint64 s_defaultQuantum = 1000 * 1000; // microsecond
+static constexpr auto s_sheetColumns = 10;
+static constexpr auto s_sheetTiles = 100;
+static constexpr auto s_sheetQuality = 85;
+static const QString s_indexFileName = "index.json";
+
+struct ThumbnailKey
+{
+    auto operator==(const ThumbnailKey &other) const -> bool
+    {
+        return fileId == other.fileId && streamIndex == other.streamIndex
+               && timestamp == other.timestamp && size == other.size;
+    }
+
+    QString fileId;
+    int streamIndex = -1;
+    qint64 timestamp = 0;
+    QSize size;
+};
+
+static auto qHash(const ThumbnailKey &key, size_t seed = 0) -> size_t
+{
+    return qHashMulti(seed,
+                      key.fileId,
+                      key.streamIndex,
+                      key.timestamp,
+                      key.size.width(),
+                      key.size.height());
+}
+
+class ThumbnailCache::ThumbnailCachePrivate
+{
+public:
+    struct Tile
+    {
+        qint64 timestamp = 0;
+        qint64 pts = 0;
+        QString chapterText;
+        QRect rect; // in the sheet
+    };
+
+    struct Sheet
+    {
+        quint64 id = 0;
+        QString fileName; // empty until written
+        int streamIndex = -1;
+        QSize size;
+        QList<Tile> tiles;
+        QList<QImage> images; // until written
+        bool writing = false; // taken by writeSheets(), still found in pendingSheets
+    };
+
+    // the sprite sheets of one file identity
+    struct DiskEntry
+    {
+        QString fileId;
+        QString dirPath;
+        QList<Sheet> sheets;
+        QList<Sheet> pendingSheets;
+    };
+
+    // a copy of a pending sheet, painted and encoded without the mutex
+    struct SheetWrite
+    {
+        QString fileId;
+        QString dirPath;
+        Sheet sheet;
+    };
+
+    explicit ThumbnailCachePrivate(ThumbnailCache *q)
+        : q_ptr(q)
+    {
+        cache.setMaxCost(s_defaultMaxBytes);
+    }
+
+    void insertMemory(const ThumbnailKey &key, const Thumbnail &thumbnail)
+    {
+        auto cost = qMax<qsizetype>(1, thumbnail.image.sizeInBytes());
+        cache.insert(key, new Thumbnail(thumbnail), cost);
+    }
+
+    auto diskEntry(const QString &filepath, const QString &fileId) -> DiskEntry *
+    {
+        if (diskCachePath.isEmpty()) {
+            return nullptr;
+        }
+        auto iter = diskEntries.find(fileId);
+        if (iter != diskEntries.end()) {
+            return &iter.value();
+        }
+        DiskEntry entry;
+        entry.fileId = fileId;
+        entry.dirPath = QDir(diskCachePath).filePath(
+            QCryptographicHash::hash(filepath.toUtf8(), QCryptographicHash::Sha1).toHex());
+        // an older identity of the same file
+        for (auto it = diskEntries.begin(); it != diskEntries.end();) {
+            it = it->dirPath == entry.dirPath ? diskEntries.erase(it) : std::next(it);
+        }
+        if (!loadIndex(entry)) {
+            QDir(entry.dirPath).removeRecursively();
+            entry.sheets.clear();
+        }
+        return &diskEntries.insert(fileId, entry).value();
+    }
+
+    static auto loadIndex(DiskEntry &entry) -> bool
+    {
+        QFile file(QDir(entry.dirPath).filePath(s_indexFileName));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        auto object = QJsonDocument::fromJson(file.readAll()).object();
+        if (object.value("identity").toString() != entry.fileId) {
+            qInfo() << "Thumbnail cache of" << entry.dirPath << "is out of date";
+            return false;
+        }
+        const auto sheets = object.value("sheets").toArray();
+        for (const auto &sheetValue : sheets) {
+            auto sheetObject = sheetValue.toObject();
+            Sheet sheet;
+            sheet.fileName = sheetObject.value("file").toString();
+            sheet.streamIndex = sheetObject.value("stream").toInt(-1);
+            sheet.size = QSize(sheetObject.value("width").toInt(),
+                               sheetObject.value("height").toInt());
+            const auto tiles = sheetObject.value("tiles").toArray();
+            for (const auto &tileValue : tiles) {
+                auto tileObject = tileValue.toObject();
+                Tile tile;
+                tile.timestamp = tileObject.value("timestamp").toInteger();
+                tile.pts = tileObject.value("pts").toInteger();
+                tile.chapterText = tileObject.value("chapter").toString();
+                tile.rect = QRect(tileObject.value("x").toInt(),
+                                  tileObject.value("y").toInt(),
+                                  tileObject.value("w").toInt(),
+                                  tileObject.value("h").toInt());
+                sheet.tiles.append(tile);
+            }
+            entry.sheets.append(sheet);
+        }
+        return true;
+    }
+
+    static auto writeIndex(const DiskEntry &entry) -> bool
+    {
+        QJsonArray sheets;
+        for (const auto &sheet : std::as_const(entry.sheets)) {
+            QJsonArray tiles;
+            for (const auto &tile : std::as_const(sheet.tiles)) {
+                tiles.append(QJsonObject{{"timestamp", tile.timestamp},
+                                         {"pts", tile.pts},
+                                         {"chapter", tile.chapterText},
+                                         {"x", tile.rect.x()},
+                                         {"y", tile.rect.y()},
+                                         {"w", tile.rect.width()},
+                                         {"h", tile.rect.height()}});
+            }
+            sheets.append(QJsonObject{{"file", sheet.fileName},
+                                      {"stream", sheet.streamIndex},
+                                      {"width", sheet.size.width()},
+                                      {"height", sheet.size.height()},
+                                      {"tiles", tiles}});
+        }
+        QJsonObject object{{"identity", entry.fileId}, {"sheets", sheets}};
+
+        QSaveFile file(QDir(entry.dirPath).filePath(s_indexFileName));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << file.errorString();
+            return false;
+        }
+        file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+        return file.commit();
+    }
+
+    // tiles in rows of s_sheetColumns cells of the thumbnail size, sets the rects of the tiles
+    static auto writeSheet(const QString &dirPath, const QString &fileName, Sheet &sheet) -> bool
+    {
+        if (sheet.images.isEmpty() || !QDir().mkpath(dirPath)) {
+            return false;
+        }
+        auto columns = qMin<qsizetype>(s_sheetColumns, sheet.images.size());
+        auto rows = (sheet.images.size() + s_sheetColumns - 1) / s_sheetColumns;
+        QImage sheetImage(sheet.size.width() * columns,
+                          sheet.size.height() * rows,
+                          QImage::Format_RGB32);
+        sheetImage.fill(Qt::black);
+        QPainter painter(&sheetImage);
+        for (int i = 0; i < sheet.images.size(); i++) {
+            const auto &image = sheet.images.at(i);
+            QRect rect(QPoint(i % s_sheetColumns * sheet.size.width(),
+                              i / s_sheetColumns * sheet.size.height()),
+                       image.size().boundedTo(sheet.size));
+            painter.drawImage(rect.topLeft(), image, QRect(QPoint(0, 0), rect.size()));
+            sheet.tiles[i].rect = rect;
+        }
+        painter.end();
+
+        QImageWriter writer(QDir(dirPath).filePath(fileName), "jpg");
+        writer.setQuality(s_sheetQuality);
+        if (!writer.write(sheetImage)) {
+            qWarning() << writer.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    // under the mutex, marks the sheets to write; all takes the ones not full yet as well
+    static auto takePendingSheets(DiskEntry &entry, bool all) -> QList<SheetWrite>
+    {
+        QList<SheetWrite> sheetWrites;
+        for (auto &sheet : entry.pendingSheets) {
+            if (sheet.writing || (!all && sheet.tiles.size() < s_sheetTiles)) {
+                continue;
+            }
+            sheet.writing = true;
+            sheetWrites.append({entry.fileId, entry.dirPath, sheet});
+        }
+        return sheetWrites;
+    }
+
+    // without the mutex; one writer at a time keeps the file names and the index consistent
+    void writeSheets(const QList<SheetWrite> &sheetWrites)
+    {
+        if (sheetWrites.isEmpty()) {
+            return;
+        }
+        QMutexLocker writeLocker(&writeMutex);
+        for (auto sheetWrite : sheetWrites) {
+            auto &sheet = sheetWrite.sheet;
+            QString fileName;
+            {
+                QMutexLocker locker(&mutex);
+                auto *entry = writingEntry(sheetWrite);
+                if (entry == nullptr) {
+                    continue;
+                }
+                fileName = QString("%1_%2x%3_%4.jpg")
+                               .arg(QString::number(sheet.streamIndex),
+                                    QString::number(sheet.size.width()),
+                                    QString::number(sheet.size.height()),
+                                    QString::number(entry->sheets.size()));
+            }
+            auto ok = writeSheet(sheetWrite.dirPath, fileName, sheet);
+
+            DiskEntry index;
+            {
+                QMutexLocker locker(&mutex);
+                auto *entry = writingEntry(sheetWrite);
+                if (entry == nullptr) {
+                    continue;
+                }
+                entry->pendingSheets.removeIf(
+                    [&](const Sheet &pending) { return pending.id == sheet.id; });
+                if (!ok) {
+                    continue;
+                }
+                sheet.fileName = fileName;
+                sheet.images.clear();
+                sheet.writing = false;
+                entry->sheets.append(sheet);
+                index = *entry;
+            }
+            writeIndex(index);
+        }
+    }
+
+    // the entry the sheet was taken from, null if it was dropped or reset meanwhile
+    auto writingEntry(const SheetWrite &sheetWrite) -> DiskEntry *
+    {
+        auto iter = diskEntries.find(sheetWrite.fileId);
+        if (iter == diskEntries.end() || iter->dirPath != sheetWrite.dirPath
+            || std::none_of(iter->pendingSheets.cbegin(),
+                            iter->pendingSheets.cend(),
+                            [&](const Sheet &pending) {
+                                return pending.id == sheetWrite.sheet.id;
+                            })) {
+            return nullptr;
+        }
+        return &iter.value();
+    }
+
+    // a pending tile is found right away, a written one sets the sheet to read without the mutex
+    auto findDisk(const QString &filepath,
+                  const ThumbnailKey &key,
+                  Thumbnail &thumbnail,
+                  QString &sheetPath,
+                  QList<Tile> &sheetTiles) -> bool
+    {
+        auto *entry = diskEntry(filepath, key.fileId);
+        if (entry == nullptr) {
+            return false;
+        }
+        for (const auto &sheet : std::as_const(entry->pendingSheets)) {
+            if (sheet.streamIndex != key.streamIndex || sheet.size != key.size) {
+                continue;
+            }
+            for (int i = 0; i < sheet.tiles.size(); i++) {
+                const auto &tile = sheet.tiles.at(i);
+                if (tile.timestamp == key.timestamp) {
+                    thumbnail = {sheet.images.at(i), tile.pts, tile.chapterText};
+                    insertMemory(key, thumbnail);
+                    return true;
+                }
+            }
+        }
+        for (const auto &sheet : std::as_const(entry->sheets)) {
+            if (sheet.streamIndex != key.streamIndex || sheet.size != key.size
+                || std::none_of(sheet.tiles.cbegin(), sheet.tiles.cend(), [&](const Tile &tile) {
+                       return tile.timestamp == key.timestamp;
+                   })) {
+                continue;
+            }
+            sheetPath = QDir(entry->dirPath).filePath(sheet.fileName);
+            sheetTiles = sheet.tiles;
+            return false;
+        }
+        return false;
+    }
+
+    // without the mutex
+    static auto readSheet(const QString &sheetPath,
+                          const QList<Tile> &sheetTiles,
+                          const ThumbnailKey &key,
+                          QList<QPair<ThumbnailKey, Thumbnail>> &tileThumbnails) -> bool
+    {
+        QImageReader reader(sheetPath);
+        auto sheetImage = reader.read();
+        if (sheetImage.isNull()) {
+            qWarning() << reader.errorString();
+            return false;
+        }
+        // the neighbours are likely the next hovers
+        auto tileKey = key;
+        for (const auto &tile : std::as_const(sheetTiles)) {
+            tileKey.timestamp = tile.timestamp;
+            tileThumbnails.append(
+                {tileKey, {sheetImage.copy(tile.rect), tile.pts, tile.chapterText}});
+        }
+        return true;
+    }
+
+    // the full sheets to write
+    auto insertDisk(const QString &filepath, const ThumbnailKey &key, const Thumbnail &thumbnail)
+        -> QList<SheetWrite>
+    {
+        auto *entry = diskEntry(filepath, key.fileId);
+        if (entry == nullptr) {
+            return {};
+        }
+        auto contains = [&](const Sheet &sheet) {
+            return sheet.streamIndex == key.streamIndex && sheet.size == key.size
+                   && std::any_of(sheet.tiles.cbegin(), sheet.tiles.cend(), [&](const Tile &tile) {
+                          return tile.timestamp == key.timestamp;
+                      });
+        };
+        if (std::any_of(entry->sheets.cbegin(), entry->sheets.cend(), contains)
+            || std::any_of(entry->pendingSheets.cbegin(), entry->pendingSheets.cend(), contains)) {
+            return {};
+        }
+        auto it = std::find_if(entry->pendingSheets.begin(),
+                               entry->pendingSheets.end(),
+                               [&](const Sheet &sheet) {
+                                   return !sheet.writing && sheet.streamIndex == key.streamIndex
+                                          && sheet.size == key.size;
+                               });
+        if (it == entry->pendingSheets.end()) {
+            Sheet sheet;
+            sheet.id = ++sheetId;
+            sheet.streamIndex = key.streamIndex;
+            sheet.size = key.size;
+            it = entry->pendingSheets.insert(entry->pendingSheets.end(), sheet);
+        }
+        it->tiles.append({key.timestamp, thumbnail.pts, thumbnail.chapterText, {}});
+        it->images.append(thumbnail.image);
+        return takePendingSheets(*entry, false);
+    }
+
+    ThumbnailCache *q_ptr;
+
+    mutable QMutex mutex;
+    QMutex writeMutex; // taken before mutex
+    QCache<ThumbnailKey, Thumbnail> cache;
+    qint64 quantum = s_defaultQuantum;
+    QString diskCachePath;
+    QHash<QString, DiskEntry> diskEntries;
+    quint64 sheetId = 0;
+};
+
+ThumbnailCache::ThumbnailCache()
+    : d_ptr(new ThumbnailCachePrivate(this))
+{}
+
+ThumbnailCache::~ThumbnailCache() = default;
+
+auto ThumbnailCache::fileIdentity(const QString &filepath) -> QString
+{
+    QFileInfo fileInfo(filepath);
+    if (!fileInfo.isFile()) {
+        return filepath;
+    }
+    return QString("%1|%2|%3")
+        .arg(fileInfo.absoluteFilePath(),
+             QString::number(fileInfo.size()),
+             QString::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+}
+
+void ThumbnailCache::setMaxBytes(qint64 bytes)
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->cache.setMaxCost(qMax<qint64>(0, bytes));
+}
+
+auto ThumbnailCache::maxBytes() const -> qint64
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    return d_ptr->cache.maxCost();
+}
+
+auto ThumbnailCache::bytes() const -> qint64
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    return d_ptr->cache.totalCost();
+}
+
+void ThumbnailCache::setQuantum(qint64 quantum)
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->quantum = qMax<qint64>(1, quantum);
+}
+
+auto ThumbnailCache::quantum() const -> qint64
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    return d_ptr->quantum;
+}
+
+auto ThumbnailCache::quantize(qint64 timestamp) const -> qint64
+{
+    auto step = quantum();
+    return (timestamp + step / 2) / step * step;
+}
+
+void ThumbnailCache::setDiskCachePath(const QString &path)
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->diskCachePath = path;
+    d_ptr->diskEntries.clear();
+}
+
+auto ThumbnailCache::diskCachePath() const -> QString
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    return d_ptr->diskCachePath;
+}
+
+auto ThumbnailCache::find(const QString &filepath,
+                          int streamIndex,
+                          qint64 timestamp,
+                          const QSize &size,
+                          Thumbnail &thumbnail) -> bool
+{
+    ThumbnailKey key{fileIdentity(filepath), streamIndex, timestamp, size};
+    QString sheetPath;
+    QList<ThumbnailCachePrivate::Tile> sheetTiles;
+    {
+        QMutexLocker locker(&d_ptr->mutex);
+        if (const auto *cached = d_ptr->cache.object(key)) {
+            thumbnail = *cached;
+            return true;
+        }
+        if (d_ptr->findDisk(filepath, key, thumbnail, sheetPath, sheetTiles)) {
+            return true;
+        }
+    }
+    QList<QPair<ThumbnailKey, Thumbnail>> tileThumbnails;
+    if (sheetPath.isEmpty()
+        || !ThumbnailCachePrivate::readSheet(sheetPath, sheetTiles, key, tileThumbnails)) {
+        return false;
+    }
+    QMutexLocker locker(&d_ptr->mutex);
+    for (const auto &[tileKey, tileThumbnail] : std::as_const(tileThumbnails)) {
+        if (tileKey == key) {
+            thumbnail = tileThumbnail;
+        }
+        d_ptr->insertMemory(tileKey, tileThumbnail);
+    }
+    return true;
+}
+
+void ThumbnailCache::insert(const QString &filepath,
+                            int streamIndex,
+                            qint64 timestamp,
+                            const QSize &size,
+                            const Thumbnail &thumbnail)
+{
+    if (thumbnail.image.isNull()) {
+        return;
+    }
+    ThumbnailKey key{fileIdentity(filepath), streamIndex, timestamp, size};
+    QList<ThumbnailCachePrivate::SheetWrite> sheetWrites;
+    {
+        QMutexLocker locker(&d_ptr->mutex);
+        d_ptr->insertMemory(key, thumbnail);
+        sheetWrites = d_ptr->insertDisk(filepath, key, thumbnail);
+    }
+    d_ptr->writeSheets(sheetWrites);
+}
+
+void ThumbnailCache::sync()
+{
+    QList<ThumbnailCachePrivate::SheetWrite> sheetWrites;
+    {
+        QMutexLocker locker(&d_ptr->mutex);
+        for (auto &entry : d_ptr->diskEntries) {
+            sheetWrites.append(ThumbnailCachePrivate::takePendingSheets(entry, true));
+        }
+    }
+    d_ptr->writeSheets(sheetWrites);
+}
+
+void ThumbnailCache::clear()
+{
+    QMutexLocker locker(&d_ptr->mutex);
+    d_ptr->cache.clear();
+    d_ptr->diskEntries.clear();
+}
+
+} // namespace Ffmpeg
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ffmepg_global.h"
+
+#include <utils/singleton.hpp>
+
+#include <QImage>
+
+namespace Ffmpeg {
+
+struct FFMPEG_EXPORT Thumbnail
+{
+    QImage image;
+    qint64 pts = 0; // microsecond, of the decoded key frame
+    QString chapterText;
+};
+
+// Process wide cache of preview thumbnails keyed by (file, stream, timestamp, size).
+// The memory part is a LRU bounded by bytes; the optional disk part keeps the thumbnails of a
+// file as JPEG sprite sheets with an index, dropped as soon as the file's size or mtime changes
+class FFMPEG_EXPORT ThumbnailCache
+{
+public:
+    // path, size and modification time of a local file, a changed file gets a new identity
+    static auto fileIdentity(const QString &filepath) -> QString;
+
+    void setMaxBytes(qint64 bytes);
+    [[nodiscard]] auto maxBytes() const -> qint64;
+    [[nodiscard]] auto bytes() const -> qint64;
+
+    // for the hover previews, timestamps closer than the quantum share a thumbnail; microsecond
+    void setQuantum(qint64 quantum);
+    [[nodiscard]] auto quantum() const -> qint64;
+    [[nodiscard]] auto quantize(qint64 timestamp) const -> qint64;
+
+    // empty disables the disk store
+    void setDiskCachePath(const QString &path);
+    [[nodiscard]] auto diskCachePath() const -> QString;
+
+    // timestamp as requested, microsecond; size is the box the thumbnail was scaled into
+    auto find(const QString &filepath,
+              int streamIndex,
+              qint64 timestamp,
+              const QSize &size,
+              Thumbnail &thumbnail) -> bool;
+    void insert(const QString &filepath,
+                int streamIndex,
+                qint64 timestamp,
+                const QSize &size,
+                const Thumbnail &thumbnail);
+
+    // writes the sprite sheets not full yet, needs the image plugins of a living application
+    void sync();
+    void clear();
+
+private:
+    ThumbnailCache();
+    ~ThumbnailCache();
+
+    class ThumbnailCachePrivate;
+    QScopedPointer<ThumbnailCachePrivate> d_ptr;
+
+    SINGLETON(ThumbnailCache)
+};
+
+} // namespace Ffmpeg
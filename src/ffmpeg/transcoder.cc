@@ -7,6 +7,8 @@
 #include "encodecontext.hpp"
 #include "ffmpegutils.hpp"
 #include "formatcontext.h"
+#include "keyframeindex.hpp"
+#include "memorybudget.hpp"
 #include "packet.hpp"
 #include "previewtask.hpp"
 #include "transcodercontext.hpp"
@@ -18,16 +20,77 @@
 #include <filter/filtercontext.hpp>
 #include <utils/concurrentqueue.hpp>
 #include <utils/fps.hpp>
+#include <utils/speed.hpp>
+
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <array>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
 #include <libavdevice/avdevice.h>
 #include <libavfilter/avfilter.h>
 #include <libavutil/channel_layout.h>
+#include <libavutil/time.h>
 }
 
 namespace Ffmpeg {
 
+static constexpr auto s_waitMemoryBudgetMilliseconds = 50;
+static constexpr auto s_memoryBudgetStallMilliseconds = 5000;
+static constexpr auto s_pipelinePacketQueueSize = 100;
+// decoded frames are large, a few are enough to keep the next stage busy
+static constexpr auto s_pipelineFrameQueueSize = 8;
+static constexpr auto s_pipelineMuxQueueSize = 256;
+// the stitched video may run this far ahead of the demuxed streams
+static constexpr qint64 s_segmentReadAhead = AV_TIME_BASE; // microsecond
+// streams are interleaved, the demuxer stops once any of them is this far past the range end
+static constexpr qint64 s_rangeEndMargin = AV_TIME_BASE; // microsecond
+
+struct AVBSFContextDeleter
+{
+    void operator()(AVBSFContext *ctx) const noexcept { av_bsf_free(&ctx); }
+};
+using AVBSFContextPtr = std::unique_ptr<AVBSFContext, AVBSFContextDeleter>;
+
+// h264 and hevc from mp4, mov or mkv are length prefixed (avcC, hvcC), while the re-encoded GOPs
+// of a smart cut are Annex B; bsfCtx stays null if the stream has start codes already
+static auto openAnnexBFilter(const AVStream *stream, AVBSFContextPtr &bsfCtx) -> bool
+{
+    bsfCtx.reset();
+    const auto *codecpar = stream->codecpar;
+    const char *name = nullptr;
+    switch (codecpar->codec_id) {
+    case AV_CODEC_ID_H264: name = "h264_mp4toannexb"; break;
+    case AV_CODEC_ID_HEVC: name = "hevc_mp4toannexb"; break;
+    default: return true;
+    }
+    // avcC and hvcC start with configurationVersion 1, Annex B with a start code
+    if (codecpar->extradata == nullptr || codecpar->extradata_size < 1
+        || codecpar->extradata[0] != 1) {
+        return true;
+    }
+    const auto *filter = av_bsf_get_by_name(name);
+    if (filter == nullptr) {
+        qWarning() << "Bitstream filter" << name << "not found";
+        return false;
+    }
+    AVBSFContext *ctx = nullptr;
+    auto ret = av_bsf_alloc(filter, &ctx);
+    ERROR_RETURN(ret)
+    bsfCtx.reset(ctx);
+    ret = avcodec_parameters_copy(ctx->par_in, codecpar);
+    ERROR_RETURN(ret)
+    ctx->time_base_in = stream->time_base;
+    ret = av_bsf_init(ctx);
+    ERROR_RETURN(ret)
+    return true;
+}
+
 static void copyStreamInfo(AVStream *dst, const AVStream *src)
 {
     av_dict_copy(&dst->metadata, src->metadata, 0);
@@ -45,16 +108,7 @@ static auto addSamplesToFifo(Ffmpeg::TranscoderContext *transcodeCtx, const Fram
     if (audioFifoPtr.isNull()) {
         return false;
     }
-    const int output_frame_size
-        = transcodeCtx->encContextInfoPtr->codecCtx()->avCodecCtx()->frame_size;
-    auto *avFrame = framePtr->avFrame();
-    if (audioFifoPtr->size() >= output_frame_size) {
-        return true;
-    }
-    if (!audioFifoPtr->realloc(audioFifoPtr->size() + avFrame->nb_samples)) {
-        return false;
-    }
-    return audioFifoPtr->write(reinterpret_cast<void **>(avFrame->data), avFrame->nb_samples);
+    return audioFifoPtr->write(framePtr);
 }
 
 static auto takeSamplesFromFifo(Ffmpeg::TranscoderContext *transcodeCtx, bool finished = false)
@@ -65,43 +119,32 @@ static auto takeSamplesFromFifo(Ffmpeg::TranscoderContext *transcodeCtx, bool fi
         return nullptr;
     }
     auto *enc_ctx = transcodeCtx->encContextInfoPtr->codecCtx()->avCodecCtx();
-    if (audioFifoPtr->size() < enc_ctx->frame_size && !finished) {
-        return nullptr;
-    }
-    const int frame_size = FFMIN(audioFifoPtr->size(), enc_ctx->frame_size);
-    FramePtr framePtr(new Frame);
-    auto *avFrame = framePtr->avFrame();
-    avFrame->nb_samples = frame_size;
-    av_channel_layout_copy(&avFrame->ch_layout, &enc_ctx->ch_layout);
-    avFrame->format = enc_ctx->sample_fmt;
-    avFrame->sample_rate = enc_ctx->sample_rate;
-    if (!framePtr->getBuffer()) {
-        return nullptr;
-    }
-    if (!audioFifoPtr->read(reinterpret_cast<void **>(framePtr->avFrame()->data), frame_size)) {
+    // encoders with a variable frame size take whatever there is
+    auto frame_size = enc_ctx->frame_size > 0 ? enc_ctx->frame_size : audioFifoPtr->size();
+    if (audioFifoPtr->size() < frame_size && !finished) {
         return nullptr;
     }
-    // fix me?
-    avFrame->pts = transcodeCtx->audioPts / av_q2d(transcodeCtx->decContextInfoPtr->timebase())
-                   / transcodeCtx->decContextInfoPtr->codecCtx()->avCodecCtx()->sample_rate;
-    transcodeCtx->audioPts += avFrame->nb_samples;
-    //qDebug() << "new: " << stream_index << frame->pts;
-
-    return framePtr;
+    // pts from the fifo, counted in samples
+    return audioFifoPtr->read(FFMIN(audioFifoPtr->size(), frame_size));
 }
 
 class Transcoder::TranscoderPrivate
 {
 public:
+    enum class Stage { Demux, Decode, Filter, Encode, Mux, Count };
+
     explicit TranscoderPrivate(Transcoder *q)
         : q_ptr(q)
         , inFormatContext(new FormatContext(q_ptr))
         , outFormatContext(new FormatContext(q_ptr))
         , fpsPtr(new Utils::Fps)
+        , writeSpeedPtr(new Utils::Speed)
     {
         threadPool = new QThreadPool(q_ptr);
         threadPool->setMaxThreadCount(2);
 
+        inFormatContext->setInterruptCallback([this] { return !runing.load(); });
+
         QObject::connect(AVErrorManager::instance(),
                          &AVErrorManager::error,
                          q_ptr,
@@ -121,6 +164,8 @@ public:
         }
         decodeContexts.clear();
         inFormatContext->findStream();
+        // starts the background key frame scan, ready for the segments by the time it's needed
+        inFormatContext->keyFrameIndex();
         auto stream_num = inFormatContext->streams();
         for (int i = 0; i < stream_num; i++) {
             auto *transContext = new TranscoderContext;
@@ -154,9 +199,8 @@ public:
         }
         inFormatContext->dumpFormat();
 
-        range = {0, inFormatContext->duration()};
-
         if (eventChanged) {
+            range = {0, inFormatContext->duration()};
             auto tracks = inFormatContext->audioTracks();
             tracks.append(inFormatContext->videoTracks());
             tracks.append(inFormatContext->subtitleTracks());
@@ -167,29 +211,63 @@ public:
         return true;
     }
 
-    auto openOutputFile() const -> bool
+    [[nodiscard]] auto outputCount() const -> int { return renditions.size() + 1; }
+
+    [[nodiscard]] auto outputContext(int output) const -> FormatContext *
+    {
+        return output == 0 ? outFormatContext : renditions.at(output - 1).formatContext.data();
+    }
+
+    auto outputQueue(int output) -> Utils::BoundedBlockingQueue<PacketPtr> &
+    {
+        return output == 0 ? muxQueue : *renditions.at(output - 1).muxQueue;
+    }
+
+    [[nodiscard]] auto outputEncodeContext(int output, int inStreamIndex) const -> EncodeContext
     {
-        Q_ASSERT(!outFilepath.isEmpty());
-        auto ret = outFormatContext->openFilePath(outFilepath, FormatContext::WriteOnly);
+        if (output == 0) {
+            return encodeContexts.at(inStreamIndex);
+        }
+        return renditions.at(output - 1).encodeContexts.value(inStreamIndex,
+                                                               encodeContexts.at(inStreamIndex));
+    }
+
+    // the renditions take the streams of the main output, with their own encoders
+    auto openOutputFile(int output) const -> bool
+    {
+        auto *formatContext = outputContext(output);
+        auto filepath = output == 0 ? outFilepath : renditions.at(output - 1).filepath;
+        Q_ASSERT(!filepath.isEmpty());
+        auto ret = formatContext->openFilePath(filepath, FormatContext::WriteOnly);
         if (!ret) {
             return ret;
         }
-        outFormatContext->copyChapterFrom(inFormatContext);
+        formatContext->copyChapterFrom(inFormatContext);
         auto stream_num = inFormatContext->streams();
         int outStreamIndex = 0;
         for (int i = 0; i < stream_num; i++) {
-            auto encodeContext = encodeContexts.at(i);
+            auto encodeContext = outputEncodeContext(output, i);
 
             auto *transContext = transcodeContexts.at(i);
-            transContext->vaild = (encodeContext.streamIndex >= 0);
+            if (output == 0) {
+                transContext->vaild = (encodeContext.streamIndex >= 0);
+            }
             if (!transContext->vaild) {
                 continue;
             }
+            if (output > 0) {
+                QSharedPointer<TranscoderContext> renditionContext(new TranscoderContext);
+                renditionContext->decContextInfoPtr = transContext->decContextInfoPtr;
+                renditionContext->vaild = true;
+                renditionContext->output = output;
+                transContext->renditionContexts.append(renditionContext);
+                transContext = renditionContext.data();
+            }
             transContext->outStreamIndex = outStreamIndex;
             outStreamIndex++;
 
             auto *inStream = inFormatContext->stream(i);
-            auto *stream = outFormatContext->createStream();
+            auto *stream = formatContext->createStream();
             if (stream == nullptr) {
                 return false;
             }
@@ -215,28 +293,28 @@ public:
             switch (decContextInfo->mediaType()) {
             case AVMEDIA_TYPE_AUDIO:
             case AVMEDIA_TYPE_VIDEO: {
-                QSharedPointer<AVContextInfo> contextInfoPtr(new AVContextInfo);
-                contextInfoPtr->setIndex(transContext->outStreamIndex);
-                contextInfoPtr->setStream(stream);
-                contextInfoPtr->initEncoder(encodeContext.codecInfo().name);
-                auto *codecCtx = contextInfoPtr->codecCtx();
-                auto *avCodecCtx = codecCtx->avCodecCtx();
-                decContextInfo->codecCtx()->copyToCodecParameters(codecCtx);
-                // ffmpeg example transcoding.c ? framerate, sample_rate
-                codecCtx->avCodecCtx()->time_base = decContextInfo->timebase();
-                codecCtx->setEncodeParameters(encodeContext);
-                if ((outFormatContext->avFormatContext()->oformat->flags & AVFMT_GLOBALHEADER)
-                    != 0) {
-                    avCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-                }
-                if (!contextInfoPtr->openCodec(AVContextInfo::GpuEncode)) {
+                auto contextInfoPtr = openEncoder(decContextInfo.data(),
+                                                  encodeContext,
+                                                  stream,
+                                                  transContext->outStreamIndex,
+                                                  isGlobalHeader(output));
+                if (contextInfoPtr.isNull()) {
                     return false;
                 }
-                auto ret = avcodec_parameters_from_context(stream->codecpar,
-                                                           contextInfoPtr->codecCtx()->avCodecCtx());
-                if (ret < 0) {
-                    SET_ERROR_CODE(ret);
-                    return ret != 0;
+                // the copied GOPs keep the source's parameters, as Annex B like the re-encoded
+                // ones, which bring their headers in band
+                if (output == 0 && i == smartCutStreamIndex) {
+                    AVBSFContextPtr annexBFilter;
+                    if (!openAnnexBFilter(inStream, annexBFilter)) {
+                        return false;
+                    }
+                    auto ret = avcodec_parameters_copy(stream->codecpar,
+                                                       annexBFilter ? annexBFilter->par_out
+                                                                    : inStream->codecpar);
+                    if (ret < 0) {
+                        SET_ERROR_CODE(ret);
+                        return false;
+                    }
                 }
                 stream->time_base = decContextInfo->timebase();
                 transContext->encContextInfoPtr = contextInfoPtr;
@@ -254,16 +332,64 @@ public:
             } break;
             }
         }
-        outFormatContext->dumpFormat();
-        if (!outFormatContext->avioOpen()) {
+        formatContext->dumpFormat();
+        formatContext->setIoBufferSize(ioBufferSize);
+        if (!formatContext->avioOpen()) {
             return false;
         }
-        return outFormatContext->writeHeader();
+        return formatContext->writeHeader();
     }
 
-    void initFilters(int inStreamIndex, const FramePtr &framePtr)
+    [[nodiscard]] auto openOutputFiles() const -> bool
+    {
+        for (int i = 0; i < outputCount(); i++) {
+            if (!openOutputFile(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto isGlobalHeader(int output = 0) const -> bool
+    {
+        auto *formatContext = outputContext(output);
+        return (formatContext->avFormatContext()->oformat->flags & AVFMT_GLOBALHEADER) != 0;
+    }
+
+    static auto openEncoder(AVContextInfo *decContextInfo,
+                            const EncodeContext &encodeContext,
+                            AVStream *stream,
+                            int outStreamIndex,
+                            bool globalHeader) -> QSharedPointer<AVContextInfo>
+    {
+        QSharedPointer<AVContextInfo> contextInfoPtr(new AVContextInfo);
+        contextInfoPtr->setIndex(outStreamIndex);
+        contextInfoPtr->setStream(stream);
+        contextInfoPtr->initEncoder(encodeContext.codecInfo().name);
+        auto *codecCtx = contextInfoPtr->codecCtx();
+        auto *avCodecCtx = codecCtx->avCodecCtx();
+        decContextInfo->codecCtx()->copyToCodecParameters(codecCtx);
+        // ffmpeg example transcoding.c ? framerate, sample_rate
+        avCodecCtx->time_base = decContextInfo->timebase();
+        codecCtx->setEncodeParameters(encodeContext);
+        if (globalHeader) {
+            avCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        if (!contextInfoPtr->openCodec(AVContextInfo::GpuEncode)) {
+            return {};
+        }
+        auto ret = avcodec_parameters_from_context(stream->codecpar, avCodecCtx);
+        if (ret < 0) {
+            SET_ERROR_CODE(ret);
+            return {};
+        }
+        return contextInfoPtr;
+    }
+
+    void initFilters(TranscoderContext *transcodeCtx,
+                     int inStreamIndex,
+                     const FramePtr &framePtr) const
     {
-        auto *transcodeCtx = transcodeContexts.at(inStreamIndex);
         if (transcodeCtx->decContextInfoPtr.isNull()) {
             return;
         }
@@ -271,32 +397,55 @@ public:
         if (codec_type != AVMEDIA_TYPE_AUDIO && codec_type != AVMEDIA_TYPE_VIDEO) {
             return;
         }
-        QString filter_spec;
-        switch (codec_type) {
-        case AVMEDIA_TYPE_VIDEO: {
-            auto encodeContext = encodeContexts.at(inStreamIndex);
-            auto original_size = encodeContext.size;
-            if (original_size.isValid()) { // "scale=320:240"
-                filter_spec = QString("scale=%1:%2")
-                                  .arg(QString::number(original_size.width()),
-                                       QString::number(original_size.height()));
-            }
-            if (!subtitleFilename.isEmpty()) {
-                // "subtitles=filename=..." burn subtitle into video
-                if (!filter_spec.isEmpty()) {
-                    filter_spec += ",";
+        auto outputs = transcodeCtx->output == 0 ? 1 + transcodeCtx->renditionContexts.size() : 1;
+        QStringList filter_specs;
+        for (int output = 0; output < outputs; output++) {
+            QString filter_spec;
+            switch (codec_type) {
+            case AVMEDIA_TYPE_VIDEO: {
+                auto encodeContext = outputEncodeContext(output, inStreamIndex);
+                auto original_size = encodeContext.size;
+                if (original_size.isValid()) { // "scale=320:240"
+                    filter_spec = QString("scale=%1:%2")
+                                      .arg(QString::number(original_size.width()),
+                                           QString::number(original_size.height()));
+                }
+                if (!subtitleFilename.isEmpty()) {
+                    // "subtitles=filename=..." burn subtitle into video
+                    if (!filter_spec.isEmpty()) {
+                        filter_spec += ",";
+                    }
+                    filter_spec += QString("subtitles=filename='%1':original_size=%2x%3")
+                                       .arg(subtitleFilename,
+                                            QString::number(original_size.width()),
+                                            QString::number(original_size.height()));
+                }
+                if (filter_spec.isEmpty()) {
+                    filter_spec = "null";
                 }
-                filter_spec += QString("subtitles=filename='%1':original_size=%2x%3")
-                                   .arg(subtitleFilename,
-                                        QString::number(original_size.width()),
-                                        QString::number(original_size.height()));
+            } break;
+            default: filter_spec = "anull"; break;
             }
-            if (filter_spec.isEmpty()) {
-                filter_spec = "null";
+            filter_specs.append(filter_spec);
+        }
+        // renditions, "split=2[s0][s1];[s0]scale=1920:1080[out0];[s1]scale=1280:720[out1]"
+        auto filter_spec = filter_specs.first();
+        if (filter_specs.size() > 1) {
+            QStringList splits;
+            QStringList chains;
+            for (int i = 0; i < filter_specs.size(); i++) {
+                splits.append(QString("[s%1]").arg(i));
+                chains.append(
+                    QString("[s%1]%2[out%1]").arg(QString::number(i), filter_specs.at(i)));
             }
+            filter_spec = QString("%1=%2%3;%4")
+                              .arg(QString(codec_type == AVMEDIA_TYPE_VIDEO ? "split" : "asplit"),
+                                   QString::number(filter_specs.size()),
+                                   splits.join(""),
+                                   chains.join(";"));
+        }
+        if (codec_type == AVMEDIA_TYPE_VIDEO) {
             qInfo() << "Video Filter: " << filter_spec;
-        } break;
-        default: filter_spec = "anull"; break;
         }
         transcodeCtx->initFilter(filter_spec, framePtr);
     }
@@ -308,49 +457,59 @@ public:
             if (!transCtx->vaild || transCtx->decContextInfoPtr.isNull()) {
                 continue;
             }
-            if (transCtx->decContextInfoPtr->mediaType() == AVMEDIA_TYPE_AUDIO) {
-                transCtx->audioFifoPtr.reset(new AudioFifo(transCtx->encContextInfoPtr->codecCtx()));
+            if (transCtx->decContextInfoPtr->mediaType() != AVMEDIA_TYPE_AUDIO) {
+                continue;
+            }
+            // sized once, for one encoder frame and one decoded frame
+            auto inputFrameSize = transCtx->decContextInfoPtr->codecCtx()->avCodecCtx()->frame_size;
+            transCtx->audioFifoPtr.reset(
+                new AudioFifo(transCtx->encContextInfoPtr->codecCtx(), inputFrameSize));
+            for (const auto &renditionContext : std::as_const(transCtx->renditionContexts)) {
+                renditionContext->audioFifoPtr.reset(
+                    new AudioFifo(renditionContext->encContextInfoPtr->codecCtx(), inputFrameSize));
             }
         }
     }
 
     void cleanup()
     {
-        for (int i = 0; i < transcodeContexts.size(); i++) {
-            auto *transCtx = transcodeContexts.at(i);
-            if (!transCtx->vaild || !transCtx->filterPtr->isInitialized()) {
-                continue;
-            }
-            if (!transCtx->audioFifoPtr.isNull()) {
-                fliterAudioFifo(transCtx, nullptr, true);
-            }
-            FramePtr framePtr(new Frame);
-            framePtr->destroyFrame();
-            filterEncodeWriteframe(framePtr, i);
-            flushEncoder(transCtx);
+        // no trailer behind a truncated file
+        for (int i = 0; !writeFailed.load() && i < outputCount(); i++) {
+            outputContext(i)->writeTrailer();
         }
-        outFormatContext->writeTrailer();
         reset();
     }
 
-    auto filterEncodeWriteframe(const FramePtr &framePtr, int inStreamIndex) const -> bool
+    // any thread; a full disk or a dropped share stops the transcode at the first failed write
+    void failWrite()
     {
-        auto *transcodeCtx = transcodeContexts.at(inStreamIndex);
-        auto framePtrs = transcodeCtx->filterPtr->filterFrame(framePtr);
-        for (const auto &framePtr : std::as_const(framePtrs)) {
-            framePtr->setPictType(AV_PICTURE_TYPE_NONE);
-            if (transcodeCtx->audioFifoPtr.isNull()) {
-                encodeWriteFrame(transcodeCtx, framePtr, false);
-            } else {
-                fliterAudioFifo(transcodeCtx, framePtr);
+        if (writeFailed.exchange(true)) {
+            return;
+        }
+        addPropertyChangeEvent(new ErrorEvent(Transcoder::tr("Write output file failed!")));
+        runing.store(false);
+        abortPipeline();
+    }
+
+    // the first filter output is encoded for the main output, the others for the renditions
+    void filterFrame(Ffmpeg::TranscoderContext *transcodeCtx, const FramePtr &framePtr)
+    {
+        auto begin = av_gettime_relative();
+        auto outputs = transcodeCtx->filterPtr->filterFrames(framePtr);
+        addStageTime(Stage::Filter, begin);
+        for (int i = 0; i < outputs.size(); i++) {
+            auto *encodeCtx = i == 0 ? transcodeCtx
+                                     : transcodeCtx->renditionContexts.at(i - 1).data();
+            for (const auto &framePtr : std::as_const(outputs.at(i))) {
+                framePtr->setPictType(AV_PICTURE_TYPE_NONE);
+                encodeCtx->encodeQueue.push_back(framePtr);
             }
         }
-        return true;
     }
 
     void fliterAudioFifo(Ffmpeg::TranscoderContext *transcodeCtx,
                          const FramePtr &framePtr,
-                         bool finish = false) const
+                         bool finish = false)
     {
         //qDebug() << "old: " << stream_index << frame->avFrame()->pts;
         if (nullptr != framePtr) {
@@ -367,27 +526,31 @@ public:
 
     auto encodeWriteFrame(Ffmpeg::TranscoderContext *transcodeCtx,
                           const FramePtr &framePtr,
-                          bool flush) const -> bool
+                          bool flush) -> bool
     {
         PacketPtrList packetPtrs{};
+        auto begin = av_gettime_relative();
         if (flush) {
-            FramePtr frame_tmp_ptr(new Frame);
+            auto frame_tmp_ptr = Frame::create();
             frame_tmp_ptr->destroyFrame();
             packetPtrs = transcodeCtx->encContextInfoPtr->encodeFrame(frame_tmp_ptr);
         } else {
             packetPtrs = transcodeCtx->encContextInfoPtr->encodeFrame(framePtr);
         }
+        addStageTime(Stage::Encode, begin);
         auto outStreamIndex = transcodeCtx->outStreamIndex;
+        auto *formatContext = outputContext(transcodeCtx->output);
+        auto &queue = outputQueue(transcodeCtx->output);
         for (const auto &packetPtr : std::as_const(packetPtrs)) {
             packetPtr->setStreamIndex(outStreamIndex);
             packetPtr->rescaleTs(transcodeCtx->encContextInfoPtr->timebase(),
-                                 outFormatContext->stream(outStreamIndex)->time_base);
-            outFormatContext->writePacket(packetPtr);
+                                 formatContext->stream(outStreamIndex)->time_base);
+            queue.push_back(packetPtr);
         }
         return true;
     }
 
-    auto flushEncoder(Ffmpeg::TranscoderContext *transcodeCtx) const -> bool
+    auto flushEncoder(Ffmpeg::TranscoderContext *transcodeCtx) -> bool
     {
         auto *codecCtx = transcodeCtx->encContextInfoPtr->codecCtx()->avCodecCtx();
         if ((codecCtx->codec->capabilities & AV_CODEC_CAP_DELAY) == 0) {
@@ -403,144 +566,1131 @@ public:
         return contextInfo->initDecoder(inFormatContext->guessFrameRate(index));
     }
 
-    void loop()
+    // the transcoded part of the input as timestamps, microsecond; the range counts from the
+    // start of the input, an empty one is the whole input
+    [[nodiscard]] auto inputStartTime() const -> qint64
     {
-        while (runing.load()) {
-            PacketPtr packetPtr(new Packet);
-            if (!inFormatContext->readFrame(packetPtr)) {
-                break;
-            }
-            auto stream_index = packetPtr->streamIndex();
-            auto *transcodeCtx = transcodeContexts.at(stream_index);
-            if (!transcodeCtx->vaild) {
-                continue;
-            }
+        auto startTime = inFormatContext->avFormatContext()->start_time;
+        return startTime != AV_NOPTS_VALUE ? startTime : 0;
+    }
 
-            auto decContextInfoPtr = transcodeCtx->decContextInfoPtr;
-            auto encContextInfoPtr = transcodeCtx->encContextInfoPtr;
-            auto inTimebase = inFormatContext->stream(stream_index)->time_base;
-            auto outIndex = transcodeCtx->outStreamIndex;
-            if (encContextInfoPtr.isNull()) {
-                packetPtr->rescaleTs(inTimebase, outFormatContext->stream(outIndex)->time_base);
-                packetPtr->setStreamIndex(outIndex);
-                outFormatContext->writePacket(packetPtr);
-            } else {
-                packetPtr->rescaleTs(inTimebase, transcodeCtx->decContextInfoPtr->timebase());
-                auto framePtrs = transcodeCtx->decContextInfoPtr->decodeFrame(packetPtr);
-                for (const auto &framePtr : std::as_const(framePtrs)) {
-                    if (!transcodeCtx->filterPtr->isInitialized()) {
-                        initFilters(stream_index, framePtr);
-                    }
-                    filterEncodeWriteframe(framePtr, stream_index);
-                }
+    [[nodiscard]] auto rangeStart() const -> qint64
+    {
+        return inputStartTime() + qMax<qint64>(range.first, 0);
+    }
 
-                calculatePts(packetPtr, decContextInfoPtr.data());
-                addPropertyChangeEvent(new PositionEvent(packetPtr->pts()));
-                if (transcodeCtx->decContextInfoPtr->mediaType() == AVMEDIA_TYPE_VIDEO) {
-                    fpsPtr->update();
-                }
-            }
-        }
+    [[nodiscard]] auto rangeEnd() const -> qint64
+    {
+        return range.second > range.first ? inputStartTime() + range.second
+                                          : std::numeric_limits<qint64>::max();
     }
 
-    void addPropertyChangeEvent(PropertyChangeEvent *event)
+    [[nodiscard]] auto streamStartTime(int inStreamIndex) const -> qint64
     {
-        propertyChangeEventQueue.push_back(PropertyChangeEventPtr(event));
-        while (propertyChangeEventQueue.size() > maxPropertyEventQueueSize.load()) {
-            propertyChangeEventQueue.take();
+        auto *stream = inFormatContext->stream(inStreamIndex);
+        return stream->start_time != AV_NOPTS_VALUE
+                   ? av_rescale_q(stream->start_time, stream->time_base, AV_TIME_BASE_Q)
+                   : 0;
+    }
+
+    // range of one input stream in its time base, AV_NOPTS_VALUE where it is not limited
+    [[nodiscard]] auto streamRange(int inStreamIndex) const -> QPair<qint64, qint64>
+    {
+        auto *stream = inFormatContext->stream(inStreamIndex);
+        auto startTime = streamStartTime(inStreamIndex);
+        auto endTime = startTime + inFormatContext->duration();
+        QPair<qint64, qint64> ret{AV_NOPTS_VALUE, AV_NOPTS_VALUE};
+        if (rangeStart() > startTime) {
+            ret.first = av_rescale_q(rangeStart(), AV_TIME_BASE_Q, stream->time_base);
         }
-        emit q_ptr->eventIncrease();
+        if (rangeEnd() < endTime) {
+            ret.second = av_rescale_q(rangeEnd(), AV_TIME_BASE_Q, stream->time_base);
+        }
+        return ret;
     }
 
-    void reset()
+    [[nodiscard]] auto isInRange(const FramePtr &framePtr, const AVRational &timebase) const
+        -> bool
     {
-        if (!transcodeContexts.isEmpty()) {
-            qDeleteAll(transcodeContexts);
-            transcodeContexts.clear();
+        auto pts = framePtr->avFrame()->pts;
+        if (pts == AV_NOPTS_VALUE) {
+            return true;
         }
-        inFormatContext->close();
-        outFormatContext->close();
+        pts = av_rescale_q(pts, timebase, AV_TIME_BASE_Q);
+        return pts >= rangeStart() && pts < rangeEnd();
+    }
 
-        fpsPtr->reset();
+    // key frame aligned parts of one stream, timestamps in its time base
+    struct Segment
+    {
+        qint64 start = AV_NOPTS_VALUE; // from the beginning
+        qint64 end = AV_NOPTS_VALUE;   // to the end
+        QString filepath;
+        bool copy = false; // whole GOPs, the packets are copied instead of transcoded
+    };
+
+    [[nodiscard]] auto segmentCountFor(qint64 duration) const -> int
+    {
+        if (segmentDuration > 0) {
+            return static_cast<int>((duration + segmentDuration - 1) / segmentDuration);
+        }
+        return segmentCount;
     }
 
-    static auto getKeyFrame(FormatContext *formatContext,
-                            AVContextInfo *videoInfo,
-                            qint64 timestamp,
-                            FramePtr &outPtr) -> bool
+    auto findSegments(int inStreamIndex) -> QList<Segment>
     {
-        PacketPtr packetPtr(new Packet);
-        if (!formatContext->readFrame(packetPtr)) {
-            return false;
+        auto *inStream = inFormatContext->stream(inStreamIndex);
+        auto streamStart = streamStartTime(inStreamIndex);
+        auto begin = qMax(rangeStart(), streamStart);
+        auto end = qMin(rangeEnd(), streamStart + inFormatContext->duration());
+        auto duration = end - begin;
+        auto startTime = av_rescale_q(begin, AV_TIME_BASE_Q, inStream->time_base);
+        auto count = segmentCountFor(duration);
+        if (count < 2 || duration <= 0) {
+            return {};
         }
-        if (!formatContext->checkPktPlayRange(packetPtr)) {
-        } else if (packetPtr->streamIndex() == videoInfo->index()
-                   && ((videoInfo->stream()->disposition & AV_DISPOSITION_ATTACHED_PIC) == 0)
-                   && packetPtr->isKey()) {
-            auto framePtrs = videoInfo->decodeFrame(packetPtr);
-            for (const auto &framePtr : std::as_const(framePtrs)) {
-                if (nullptr == framePtr || !framePtr->isKey()) {
-                    continue;
+
+        // the first key frame at or after each evenly spaced point
+        QList<qint64> points;
+        QList<qint64> targets;
+        for (int i = 1; i < count; i++) {
+            targets.append(startTime
+                           + av_rescale_q(duration * i / count,
+                                          AV_TIME_BASE_Q,
+                                          inStream->time_base));
+        }
+        auto indexPtr = inFormatContext->keyFrameIndex();
+        if (!indexPtr.isNull() && indexPtr->streamIndexs().contains(inStreamIndex)) {
+            for (auto target : std::as_const(targets)) {
+                KeyFrame keyFrame;
+                if (indexPtr->find(inStreamIndex, target, true, keyFrame)
+                    && (points.isEmpty() || keyFrame.pts > points.last())) {
+                    points.append(keyFrame.pts);
+                }
+            }
+            return segmentsFromPoints(inStreamIndex, points);
+        }
+
+        // no index yet, look for the key frames after a seek to each point
+        FormatContext formatContext;
+        formatContext.setInterruptCallback([this] { return !runing.load(); });
+        if (!formatContext.openFilePath(inFilePath) || !formatContext.findStream()) {
+            return {};
+        }
+        formatContext.discardStreamExcluded({inStreamIndex});
+        for (auto target : std::as_const(targets)) {
+            if (!runing.load()) {
+                break;
+            }
+            if (!formatContext.seekFrame(inStreamIndex, target)) {
+                continue;
+            }
+            forever {
+                auto packetPtr = Packet::create();
+                if (!formatContext.readFrame(packetPtr)) {
+                    break;
                 }
-                calculatePts(framePtr, videoInfo, formatContext);
-                auto pts = framePtr->pts();
-                if (timestamp > pts) {
+                auto pts = packetPtr->avPacket()->pts;
+                if (packetPtr->streamIndex() != inStreamIndex || !packetPtr->isKey()
+                    || pts == AV_NOPTS_VALUE || pts < target) {
                     continue;
                 }
-                outPtr = framePtr;
+                if (points.isEmpty() || pts > points.last()) {
+                    points.append(pts);
+                }
+                break;
             }
         }
-        return true;
+        return segmentsFromPoints(inStreamIndex, points);
     }
 
-    Transcoder *q_ptr;
-
-    QString inFilePath;
-    QString outFilepath;
-    FormatContext *inFormatContext;
-    FormatContext *outFormatContext;
-    QList<TranscoderContext *> transcodeContexts{};
-    QString subtitleFilename;
-
-    QPair<qint64, qint64> range;
+    [[nodiscard]] auto segmentsFromPoints(int inStreamIndex, const QList<qint64> &points) const
+        -> QList<Segment>
+    {
+        auto limits = streamRange(inStreamIndex);
+        QList<Segment> segments;
+        Segment segment;
+        segment.start = limits.first;
+        for (auto point : std::as_const(points)) {
+            if (limits.second != AV_NOPTS_VALUE && point >= limits.second) {
+                break;
+            }
+            segment.end = point;
+            segments.append(segment);
+            segment.start = point;
+        }
+        segment.end = limits.second;
+        segments.append(segment);
+        return segments;
+    }
 
-    EncodeContexts decodeContexts;
-    EncodeContexts encodeContexts;
+    // no key frame index yet, scans the packets of the range
+    auto findRangeKeyFrames(int inStreamIndex,
+                            const QPair<qint64, qint64> &limits,
+                            qint64 &firstKey,
+                            qint64 &lastKey) -> bool
+    {
+        FormatContext formatContext;
+        formatContext.setInterruptCallback([this] { return !runing.load(); });
+        if (!formatContext.openFilePath(inFilePath) || !formatContext.findStream()) {
+            return false;
+        }
+        formatContext.discardStreamExcluded({inStreamIndex});
+        if (limits.first != AV_NOPTS_VALUE
+            && !formatContext.seekFrame(inStreamIndex, limits.first)) {
+            return false;
+        }
+        while (runing.load()) {
+            auto packetPtr = Packet::create();
+            if (!formatContext.readFrame(packetPtr)) {
+                break;
+            }
+            auto *avPacket = packetPtr->avPacket();
+            if (packetPtr->streamIndex() != inStreamIndex) {
+                continue;
+            }
+            if (limits.second != AV_NOPTS_VALUE && avPacket->dts != AV_NOPTS_VALUE
+                && avPacket->dts > limits.second) {
+                break;
+            }
+            if (!packetPtr->isKey() || avPacket->pts == AV_NOPTS_VALUE
+                || (limits.first != AV_NOPTS_VALUE && avPacket->pts < limits.first)
+                || (limits.second != AV_NOPTS_VALUE && avPacket->pts > limits.second)) {
+                continue;
+            }
+            if (firstKey == AV_NOPTS_VALUE) {
+                firstKey = avPacket->pts;
+            }
+            lastKey = avPacket->pts;
+        }
+        return true;
+    }
 
-    std::atomic_bool runing = true;
-    QScopedPointer<Utils::Fps> fpsPtr;
+    // smart cut: whole GOPs inside the range are copied, only the partial GOPs at both ends are
+    // transcoded; needs the same codec and size as the source
+    void prepareSmartCut()
+    {
+        smartCutStreamIndex = -1;
+        smartCutSegments.clear();
+        if (!smartCut || !renditions.isEmpty()) {
+            return;
+        }
+        int inStreamIndex = -1;
+        for (int i = 0; i < inFormatContext->streams() && i < encodeContexts.size(); i++) {
+            auto *stream = inFormatContext->stream(i);
+            if (encodeContexts.at(i).streamIndex >= 0
+                && stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+                && (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) == 0) {
+                inStreamIndex = i;
+                break;
+            }
+        }
+        if (inStreamIndex < 0) {
+            return;
+        }
+        auto *inStream = inFormatContext->stream(inStreamIndex);
+        const auto &encodeContext = encodeContexts.at(inStreamIndex);
+        auto size = encodeContext.size;
+        if (encodeContext.codecInfo().codecId != inStream->codecpar->codec_id
+            || !subtitleFilename.isEmpty()
+            || (size.isValid()
+                && size != QSize(inStream->codecpar->width, inStream->codecpar->height))) {
+            qInfo() << "Smart cut needs the source codec and size, transcode the whole range";
+            return;
+        }
+        // the re-encoded GOPs are Annex B / in band, they cannot share one global header (avcC,
+        // hvcC) with the copied ones; mp4, mov and mkv are transcoded as a whole
+        auto filepath = outFilepath.toUtf8();
+        const auto *outputFormat = av_guess_format(nullptr, filepath.constData(), nullptr);
+        if (outputFormat == nullptr || (outputFormat->flags & AVFMT_GLOBALHEADER) != 0) {
+            qInfo() << "Smart cut needs an output without global headers, e.g. mpegts,"
+                    << "transcode the whole range";
+            return;
+        }
+        auto limits = streamRange(inStreamIndex);
+        if (limits.first == AV_NOPTS_VALUE && limits.second == AV_NOPTS_VALUE) {
+            return;
+        }
 
-    bool gpuDecode = true;
+        // the first and the last key frame inside the range
+        qint64 firstKey = AV_NOPTS_VALUE;
+        qint64 lastKey = AV_NOPTS_VALUE;
+        auto indexPtr = inFormatContext->keyFrameIndex();
+        if (!indexPtr.isNull() && indexPtr->streamIndexs().contains(inStreamIndex)) {
+            KeyFrame keyFrame;
+            if (indexPtr->find(inStreamIndex,
+                               limits.first != AV_NOPTS_VALUE ? limits.first : INT64_MIN,
+                               true,
+                               keyFrame)) {
+                firstKey = keyFrame.pts;
+            }
+            if (indexPtr->find(inStreamIndex,
+                               limits.second != AV_NOPTS_VALUE ? limits.second : INT64_MAX,
+                               false,
+                               keyFrame)) {
+                lastKey = keyFrame.pts;
+            }
+        } else if (!findRangeKeyFrames(inStreamIndex, limits, firstKey, lastKey)) {
+            return;
+        }
+        if (firstKey == AV_NOPTS_VALUE || lastKey <= firstKey) {
+            qInfo() << "No whole GOP inside the range, transcode the whole range";
+            return;
+        }
 
-    Utils::ConcurrentQueue<PropertyChangeEventPtr> propertyChangeEventQueue;
-    std::atomic<size_t> maxPropertyEventQueueSize = 100;
+        Segment segment;
+        if (limits.first != AV_NOPTS_VALUE && limits.first < firstKey) {
+            segment.start = limits.first;
+            segment.end = firstKey;
+            smartCutSegments.append(segment);
+        }
+        segment.start = firstKey;
+        segment.end = lastKey;
+        segment.copy = true;
+        smartCutSegments.append(segment);
+        if (limits.second == AV_NOPTS_VALUE || lastKey < limits.second) {
+            segment.start = lastKey;
+            segment.end = limits.second;
+            segment.copy = false;
+            smartCutSegments.append(segment);
+        }
+        smartCutStreamIndex = inStreamIndex;
+        qInfo() << "Smart cut stream" << inStreamIndex << "copy" << firstKey << "-" << lastKey;
+    }
 
-    FramePtrList previewFrames;
-    QThreadPool *threadPool;
-};
+    // the packets from the key frame at start up to the one at end, in decode order
+    auto copySegment(int inStreamIndex, const Segment &segment) -> bool
+    {
+        FormatContext inContext;
+        inContext.setInterruptCallback([this] { return !runing.load(); });
+        if (!inContext.openFilePath(inFilePath) || !inContext.findStream()) {
+            return false;
+        }
+        inContext.discardStreamExcluded({inStreamIndex});
+        auto *inStream = inContext.stream(inStreamIndex);
+        if (!inContext.seekFrame(inStreamIndex, segment.start)) {
+            return false;
+        }
 
-Transcoder::Transcoder(QObject *parent)
-    : QThread{parent}
-    , d_ptr(new TranscoderPrivate(this))
-{
-    av_log_set_level(AV_LOG_INFO);
-}
+        FormatContext outContext;
+        if (!outContext.openFilePath(segment.filepath, FormatContext::WriteOnly)) {
+            return false;
+        }
+        auto *outStream = outContext.createStream();
+        if (outStream == nullptr) {
+            return false;
+        }
+        AVBSFContextPtr annexBFilter;
+        if (!openAnnexBFilter(inStream, annexBFilter)) {
+            return false;
+        }
+        auto ret = avcodec_parameters_copy(outStream->codecpar,
+                                           annexBFilter ? annexBFilter->par_out
+                                                        : inStream->codecpar);
+        if (ret < 0) {
+            SET_ERROR_CODE(ret);
+            return false;
+        }
+        outStream->time_base = inStream->time_base;
+        if (!outContext.avioOpen() || !outContext.writeHeader()) {
+            return false;
+        }
 
-Transcoder::~Transcoder()
-{
-    d_ptr->threadPool->clear();
-    stopTranscode();
-}
+        auto writeOut = [&](const PacketPtr &packetPtr) -> bool {
+            packetPtr->rescaleTs(inStream->time_base, outStream->time_base);
+            packetPtr->setStreamIndex(0);
+            if (!outContext.writePacket(packetPtr)) {
+                failWrite();
+                return false;
+            }
+            return true;
+        };
+        // nullptr flushes the filter
+        auto writePacket = [&](const PacketPtr &packetPtr) -> bool {
+            if (!annexBFilter) {
+                return packetPtr == nullptr || writeOut(packetPtr);
+            }
+            ret = av_bsf_send_packet(annexBFilter.get(),
+                                     packetPtr ? packetPtr->avPacket() : nullptr);
+            if (packetPtr) {
+                packetPtr->unref(); // the filter took the reference
+            }
+            ERROR_RETURN(ret)
+            forever {
+                auto filteredPtr = Packet::create();
+                ret = av_bsf_receive_packet(annexBFilter.get(), filteredPtr->avPacket());
+                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                    return true;
+                }
+                ERROR_RETURN(ret)
+                if (!writeOut(filteredPtr)) {
+                    return false;
+                }
+            }
+        };
 
-void Transcoder::setInFilePath(const QString &filePath)
-{
+        bool started = false;
+        while (runing.load()) {
+            auto packetPtr = Packet::create();
+            if (!inContext.readFrame(packetPtr)) {
+                break;
+            }
+            if (packetPtr->streamIndex() != inStreamIndex) {
+                continue;
+            }
+            auto pts = packetPtr->avPacket()->pts;
+            if (packetPtr->isKey() && pts != AV_NOPTS_VALUE) {
+                if (pts >= segment.end) {
+                    break;
+                }
+                started = started || pts >= segment.start;
+            }
+            if (!started) {
+                continue;
+            }
+            if (!writePacket(packetPtr)) {
+                return false;
+            }
+        }
+        if (!runing.load() || !writePacket(nullptr)) {
+            return false;
+        }
+        return outContext.writeTrailer();
+    }
+
+    void encodeSegmentFrame(TranscoderContext *transcodeCtx,
+                            FormatContext *formatContext,
+                            const FramePtr &framePtr)
+    {
+        auto packetPtrs = transcodeCtx->encContextInfoPtr->encodeFrame(framePtr);
+        for (const auto &packetPtr : std::as_const(packetPtrs)) {
+            packetPtr->setStreamIndex(0);
+            packetPtr->rescaleTs(transcodeCtx->encContextInfoPtr->timebase(),
+                                 formatContext->stream(0)->time_base);
+            if (!formatContext->writePacket(packetPtr)) {
+                failWrite();
+                return;
+            }
+        }
+    }
+
+    // decodes, filters and encodes the frames of one segment into its own file
+    auto transcodeSegment(int inStreamIndex, const Segment &segment) -> bool
+    {
+        FormatContext inContext;
+        inContext.setInterruptCallback([this] { return !runing.load(); });
+        if (!inContext.openFilePath(inFilePath) || !inContext.findStream()) {
+            return false;
+        }
+        inContext.discardStreamExcluded({inStreamIndex});
+        auto *inStream = inContext.stream(inStreamIndex);
+
+        TranscoderContext transcodeCtx;
+        transcodeCtx.filterPtr.reset(new Filter);
+        transcodeCtx.decContextInfoPtr.reset(new AVContextInfo);
+        auto decContextInfoPtr = transcodeCtx.decContextInfoPtr;
+        decContextInfoPtr->setIndex(inStreamIndex);
+        decContextInfoPtr->setStream(inStream);
+        if (!decContextInfoPtr->initDecoder(inContext.guessFrameRate(inStreamIndex))
+            || !decContextInfoPtr->openCodec(gpuDecode ? AVContextInfo::GpuDecode
+                                                       : AVContextInfo::NotUseGpu)) {
+            return false;
+        }
+        if (segment.start != AV_NOPTS_VALUE && !inContext.seekFrame(inStreamIndex, segment.start)) {
+            return false;
+        }
+
+        FormatContext outContext;
+        if (!outContext.openFilePath(segment.filepath, FormatContext::WriteOnly)) {
+            return false;
+        }
+        auto *outStream = outContext.createStream();
+        if (outStream == nullptr) {
+            return false;
+        }
+        // packets are stitched into the real output, its header decides about global headers;
+        // smart cut only runs without them
+        transcodeCtx.encContextInfoPtr = openEncoder(decContextInfoPtr.data(),
+                                                     encodeContexts.at(inStreamIndex),
+                                                     outStream,
+                                                     0,
+                                                     isGlobalHeader());
+        if (transcodeCtx.encContextInfoPtr.isNull()) {
+            return false;
+        }
+        outStream->time_base = decContextInfoPtr->timebase();
+        if (!outContext.avioOpen() || !outContext.writeHeader()) {
+            return false;
+        }
+
+        bool reachedEnd = false;
+        auto processFrames = [&](const FramePtrList &framePtrs) {
+            for (const auto &framePtr : std::as_const(framePtrs)) {
+                auto pts = framePtr->avFrame()->pts;
+                if (segment.end != AV_NOPTS_VALUE && pts >= segment.end) {
+                    reachedEnd = true;
+                    continue;
+                }
+                if (segment.start != AV_NOPTS_VALUE && pts < segment.start) {
+                    continue;
+                }
+                if (!transcodeCtx.filterPtr->isInitialized()) {
+                    initFilters(&transcodeCtx, inStreamIndex, framePtr);
+                }
+                auto filteredPtrs = transcodeCtx.filterPtr->filterFrame(framePtr);
+                for (const auto &filteredPtr : std::as_const(filteredPtrs)) {
+                    filteredPtr->setPictType(AV_PICTURE_TYPE_NONE);
+                    encodeSegmentFrame(&transcodeCtx, &outContext, filteredPtr);
+                }
+            }
+        };
+        while (runing.load() && !reachedEnd) {
+            auto packetPtr = Packet::create();
+            if (!inContext.readFrame(packetPtr)) {
+                break;
+            }
+            if (packetPtr->streamIndex() != inStreamIndex) {
+                continue;
+            }
+            packetPtr->rescaleTs(inStream->time_base, decContextInfoPtr->timebase());
+            processFrames(decContextInfoPtr->decodeFrame(packetPtr));
+        }
+        if (!runing.load()) {
+            return false;
+        }
+        processFrames(decContextInfoPtr->decodeFrame(Packet::create()));
+        if (transcodeCtx.filterPtr->isInitialized()) {
+            auto framePtr = Frame::create();
+            framePtr->destroyFrame();
+            auto filteredPtrs = transcodeCtx.filterPtr->filterFrame(framePtr);
+            for (const auto &filteredPtr : std::as_const(filteredPtrs)) {
+                filteredPtr->setPictType(AV_PICTURE_TYPE_NONE);
+                encodeSegmentFrame(&transcodeCtx, &outContext, filteredPtr);
+            }
+            auto *codecCtx = transcodeCtx.encContextInfoPtr->codecCtx()->avCodecCtx();
+            if ((codecCtx->codec->capabilities & AV_CODEC_CAP_DELAY) != 0) {
+                auto flushPtr = Frame::create();
+                flushPtr->destroyFrame();
+                encodeSegmentFrame(&transcodeCtx, &outContext, flushPtr);
+            }
+        }
+        return outContext.writeTrailer();
+    }
+
+    // encodes the first transcoded video stream in key frame aligned segments in parallel, the
+    // pipeline then stitches them in instead of decoding that stream itself
+    auto transcodeSegments() -> bool
+    {
+        segmentStreamIndex = -1;
+        segmentFiles.clear();
+        // the renditions need the decoded frames of every stream
+        if (!renditions.isEmpty()) {
+            return true;
+        }
+        int inStreamIndex = smartCutStreamIndex;
+        auto segments = smartCutSegments;
+        if (inStreamIndex < 0) {
+            if (segmentCount < 2 && segmentDuration <= 0) {
+                return true;
+            }
+            for (int i = 0; i < transcodeContexts.size(); i++) {
+                auto *transCtx = transcodeContexts.at(i);
+                if (transCtx->vaild && !transCtx->encContextInfoPtr.isNull()
+                    && transCtx->decContextInfoPtr->mediaType() == AVMEDIA_TYPE_VIDEO) {
+                    inStreamIndex = i;
+                    break;
+                }
+            }
+            if (inStreamIndex < 0) {
+                return true;
+            }
+            segments = findSegments(inStreamIndex);
+            if (segments.size() < 2) {
+                return true;
+            }
+        }
+        segmentDir.reset(new QTemporaryDir);
+        if (!segmentDir->isValid()) {
+            qWarning() << "Create segment directory failed:" << segmentDir->errorString();
+            return false;
+        }
+        QStringList files;
+        for (int i = 0; i < segments.size(); i++) {
+            segments[i].filepath = segmentDir->filePath(QString("segment%1.nut").arg(i));
+            files.append(segments[i].filepath);
+        }
+        qInfo() << "Transcode" << segments.size() << "segments of stream" << inStreamIndex;
+
+        QThreadPool pool;
+        pool.setMaxThreadCount(
+            qMin(static_cast<int>(segments.size()), QThread::idealThreadCount()));
+        std::atomic_bool ok = true;
+        for (const auto &segment : std::as_const(segments)) {
+            pool.start([this, inStreamIndex, segment, &ok] {
+                if (!(segment.copy ? copySegment(inStreamIndex, segment)
+                                   : transcodeSegment(inStreamIndex, segment))) {
+                    ok = false;
+                }
+            });
+        }
+        pool.waitForDone();
+        if (!ok.load() || !runing.load()) {
+            return false;
+        }
+        segmentStreamIndex = inStreamIndex;
+        segmentFiles = files;
+        return true;
+    }
+
+    // producer for the mux stage, the segment files in order
+    void segmentStage(int inStreamIndex)
+    {
+        auto *transcodeCtx = transcodeContexts.at(inStreamIndex);
+        auto outIndex = transcodeCtx->outStreamIndex;
+        auto outTimebase = outFormatContext->stream(outIndex)->time_base;
+        qint64 lastDts = AV_NOPTS_VALUE;
+        for (const auto &filepath : std::as_const(segmentFiles)) {
+            FormatContext formatContext;
+            formatContext.setInterruptCallback([this] { return !runing.load(); });
+            if (!formatContext.openFilePath(filepath) || !formatContext.findStream()) {
+                break;
+            }
+            auto inTimebase = formatContext.stream(0)->time_base;
+            while (runing.load()) {
+                auto packetPtr = Packet::create();
+                if (!formatContext.readFrame(packetPtr)) {
+                    break;
+                }
+                packetPtr->rescaleTs(inTimebase, outTimebase);
+                packetPtr->setStreamIndex(outIndex);
+                // reordering delay of the next segment's encoder overlaps the previous one
+                auto *avPacket = packetPtr->avPacket();
+                if (lastDts != AV_NOPTS_VALUE && avPacket->dts != AV_NOPTS_VALUE
+                    && avPacket->dts <= lastDts) {
+                    avPacket->dts = lastDts + 1;
+                    if (avPacket->pts != AV_NOPTS_VALUE && avPacket->pts < avPacket->dts) {
+                        avPacket->pts = avPacket->dts;
+                    }
+                }
+                if (avPacket->dts != AV_NOPTS_VALUE) {
+                    lastDts = avPacket->dts;
+                    auto position = av_rescale_q(avPacket->dts, outTimebase, AV_TIME_BASE_Q);
+                    waitDemuxPosition(position - s_segmentReadAhead);
+                }
+                muxQueue.push_back(packetPtr);
+            }
+        }
+        muxQueue.push_back(nullptr);
+    }
+
+    void setDemuxPosition(qint64 position)
+    {
+        QMutexLocker locker(&demuxPositionMutex);
+        demuxPosition = position;
+        demuxPositionCondition.wakeAll();
+    }
+
+    // blocks until the demuxer is past position, no overflow once it stored max at the end
+    void waitDemuxPosition(qint64 position)
+    {
+        QMutexLocker locker(&demuxPositionMutex);
+        while (runing.load() && position > demuxPosition) {
+            demuxPositionCondition.wait(&demuxPositionMutex);
+        }
+    }
+
+    void decodeStage(int inStreamIndex)
+    {
+        auto *transcodeCtx = transcodeContexts.at(inStreamIndex);
+        auto decContextInfoPtr = transcodeCtx->decContextInfoPtr;
+        auto updateFps = inStreamIndex == fpsStreamIndex;
+        while (runing.load()) {
+            auto packetPtr = transcodeCtx->decodeQueue.take();
+            if (!runing.load()) {
+                break;
+            }
+            auto eof = (nullptr == packetPtr);
+            if (eof) {
+                packetPtr = Packet::create(); // flushes the delayed frames
+            }
+            auto begin = av_gettime_relative();
+            auto framePtrs = decContextInfoPtr->decodeFrame(packetPtr);
+            addStageTime(Stage::Decode, begin);
+            for (const auto &framePtr : std::as_const(framePtrs)) {
+                // decoding started at the key frame before the range
+                if (!isInRange(framePtr, decContextInfoPtr->timebase())) {
+                    continue;
+                }
+                if (updateFps) {
+                    frameCount++;
+                }
+                transcodeCtx->filterQueue.push_back(framePtr);
+            }
+            if (eof) {
+                break;
+            }
+            calculatePts(packetPtr, decContextInfoPtr.data());
+            addPropertyChangeEvent(new PositionEvent(packetPtr->pts()));
+            if (updateFps) {
+                fpsPtr->update();
+            }
+        }
+        transcodeCtx->filterQueue.push_back(nullptr);
+    }
+
+    void filterStage(int inStreamIndex)
+    {
+        auto *transcodeCtx = transcodeContexts.at(inStreamIndex);
+        while (runing.load()) {
+            auto framePtr = transcodeCtx->filterQueue.take();
+            if (nullptr == framePtr) {
+                break;
+            }
+            if (!transcodeCtx->filterPtr->isInitialized()) {
+                initFilters(transcodeCtx, inStreamIndex, framePtr);
+            }
+            // the fifos count samples from the first frame on
+            auto pts = framePtr->avFrame()->pts;
+            if (!transcodeCtx->audioFifoPtr.isNull() && !transcodeCtx->audioPtsValid
+                && pts != AV_NOPTS_VALUE) {
+                auto timebase = transcodeCtx->decContextInfoPtr->timebase();
+                transcodeCtx->audioFifoPtr->setPts(pts, timebase);
+                for (const auto &renditionCtx : std::as_const(transcodeCtx->renditionContexts)) {
+                    renditionCtx->audioFifoPtr->setPts(pts, timebase);
+                }
+                transcodeCtx->audioPtsValid = true;
+            }
+            filterFrame(transcodeCtx, framePtr);
+        }
+        if (runing.load() && transcodeCtx->filterPtr->isInitialized()) {
+            auto framePtr = Frame::create();
+            framePtr->destroyFrame();
+            filterFrame(transcodeCtx, framePtr);
+        }
+        transcodeCtx->encodeQueue.push_back(nullptr);
+        for (const auto &renditionContext : std::as_const(transcodeCtx->renditionContexts)) {
+            renditionContext->encodeQueue.push_back(nullptr);
+        }
+    }
+
+    // filterCtx owns the filter feeding transcodeCtx, itself for the main output
+    void encodeStage(TranscoderContext *transcodeCtx, TranscoderContext *filterCtx)
+    {
+        while (runing.load()) {
+            auto framePtr = transcodeCtx->encodeQueue.take();
+            if (nullptr == framePtr) {
+                break;
+            }
+            if (transcodeCtx->audioFifoPtr.isNull()) {
+                encodeWriteFrame(transcodeCtx, framePtr, false);
+            } else {
+                fliterAudioFifo(transcodeCtx, framePtr);
+            }
+        }
+        if (runing.load() && filterCtx->filterPtr->isInitialized()) {
+            if (!transcodeCtx->audioFifoPtr.isNull()) {
+                fliterAudioFifo(transcodeCtx, nullptr, true);
+            }
+            flushEncoder(transcodeCtx);
+        }
+        outputQueue(transcodeCtx->output).push_back(nullptr);
+    }
+
+    // an empty packet means one producer has finished
+    void muxStage(int output, int producers)
+    {
+        auto *formatContext = outputContext(output);
+        auto &queue = outputQueue(output);
+        // the output starts at the range start
+        QList<qint64> offsets;
+        for (int i = 0; i < formatContext->streams(); i++) {
+            offsets.append(
+                av_rescale_q(rangeStart(), AV_TIME_BASE_Q, formatContext->stream(i)->time_base));
+        }
+        while (producers > 0) {
+            auto packetPtr = queue.take();
+            if (!runing.load()) {
+                break;
+            }
+            if (nullptr == packetPtr) {
+                producers--;
+                continue;
+            }
+            auto *avPacket = packetPtr->avPacket();
+            auto offset = offsets.value(packetPtr->streamIndex());
+            if (avPacket->pts != AV_NOPTS_VALUE) {
+                avPacket->pts -= offset;
+            }
+            if (avPacket->dts != AV_NOPTS_VALUE) {
+                avPacket->dts -= offset;
+            }
+            auto size = avPacket->size; // the muxer takes the packet
+            auto begin = av_gettime_relative();
+            if (!formatContext->writePacket(packetPtr)) {
+                failWrite();
+                break;
+            }
+            addStageTime(Stage::Mux, begin);
+            writeSpeedPtr->addSize(size);
+        }
+    }
+
+    void addStage(const QString &name, std::function<void()> func)
+    {
+        auto *thread = QThread::create(std::move(func));
+        thread->setObjectName(name);
+        thread->start();
+        stages.append(thread);
+    }
+
+    // decode, filter and encode threads per transcoded stream, one more encode thread per
+    // rendition and one mux thread per output; the demuxer runs on the calling thread
+    void startPipeline()
+    {
+        QMutexLocker locker(&pipelineMutex);
+        fpsStreamIndex = -1;
+        int producers = 1; // demuxer, for the stream copies
+        int renditionProducers = 1;
+        for (int i = 0; i < transcodeContexts.size(); i++) {
+            auto *transCtx = transcodeContexts.at(i);
+            if (!transCtx->vaild || transCtx->encContextInfoPtr.isNull()) {
+                continue;
+            }
+            if (i == segmentStreamIndex) {
+                producers++;
+                continue;
+            }
+            if (fpsStreamIndex < 0
+                && transCtx->decContextInfoPtr->mediaType() == AVMEDIA_TYPE_VIDEO) {
+                fpsStreamIndex = i;
+            }
+            transCtx->decodeQueue.setMaxSize(s_pipelinePacketQueueSize);
+            transCtx->filterQueue.setMaxSize(s_pipelineFrameQueueSize);
+            transCtx->encodeQueue.setMaxSize(s_pipelineFrameQueueSize);
+            transCtx->decodeQueue.start();
+            transCtx->filterQueue.start();
+            transCtx->encodeQueue.start();
+            for (const auto &renditionContext : std::as_const(transCtx->renditionContexts)) {
+                renditionContext->encodeQueue.setMaxSize(s_pipelineFrameQueueSize);
+                renditionContext->encodeQueue.start();
+            }
+            pipelineContexts.append(transCtx);
+            producers++;
+            renditionProducers++;
+        }
+        for (int i = 0; i < outputCount(); i++) {
+            outputQueue(i).setMaxSize(muxQueueSize);
+            outputQueue(i).start();
+        }
+        for (int i = 0; i < transcodeContexts.size(); i++) {
+            auto *transCtx = transcodeContexts.at(i);
+            if (!pipelineContexts.contains(transCtx)) {
+                continue;
+            }
+            addStage(QString("TranscodeDecode%1").arg(i), [this, i] { decodeStage(i); });
+            addStage(QString("TranscodeFilter%1").arg(i), [this, i] { filterStage(i); });
+            addStage(QString("TranscodeEncode%1").arg(i),
+                     [this, transCtx] { encodeStage(transCtx, transCtx); });
+            for (const auto &renditionContext : std::as_const(transCtx->renditionContexts)) {
+                auto *renditionCtx = renditionContext.data();
+                addStage(QString("TranscodeEncode%1.%2").arg(i).arg(renditionCtx->output),
+                         [this, renditionCtx, transCtx] { encodeStage(renditionCtx, transCtx); });
+            }
+        }
+        if (segmentStreamIndex >= 0) {
+            setDemuxPosition(AV_NOPTS_VALUE);
+            addStage("TranscodeSegments", [this] { segmentStage(segmentStreamIndex); });
+        }
+        addStage("TranscodeMux", [this, producers] { muxStage(0, producers); });
+        for (int i = 1; i < outputCount(); i++) {
+            addStage(QString("TranscodeMux%1").arg(i),
+                     [this, i, renditionProducers] { muxStage(i, renditionProducers); });
+        }
+    }
+
+    // any thread, wakes up every blocked stage
+    void abortPipeline()
+    {
+        QMutexLocker locker(&pipelineMutex);
+        for (auto *transCtx : std::as_const(pipelineContexts)) {
+            transCtx->decodeQueue.abort();
+            transCtx->filterQueue.abort();
+            transCtx->encodeQueue.abort();
+            for (const auto &renditionContext : std::as_const(transCtx->renditionContexts)) {
+                renditionContext->encodeQueue.abort();
+            }
+        }
+        muxQueue.abort();
+        for (const auto &rendition : std::as_const(renditions)) {
+            rendition.muxQueue->abort();
+        }
+        QMutexLocker positionLocker(&demuxPositionMutex);
+        demuxPositionCondition.wakeAll();
+    }
+
+    void stopPipeline()
+    {
+        for (auto *thread : std::as_const(stages)) {
+            thread->wait();
+        }
+        QMutexLocker locker(&pipelineMutex);
+        qDeleteAll(stages);
+        stages.clear();
+        for (auto *transCtx : std::as_const(pipelineContexts)) {
+            transCtx->decodeQueue.clear();
+            transCtx->filterQueue.clear();
+            transCtx->encodeQueue.clear();
+            for (const auto &renditionContext : std::as_const(transCtx->renditionContexts)) {
+                renditionContext->encodeQueue.clear();
+            }
+        }
+        pipelineContexts.clear();
+        muxQueue.clear();
+        for (const auto &rendition : std::as_const(renditions)) {
+            rendition.muxQueue->clear();
+        }
+        segmentStreamIndex = -1;
+        segmentFiles.clear();
+        segmentDir.reset();
+        smartCutStreamIndex = -1;
+        smartCutSegments.clear();
+    }
+
+    // Stages that ran dry are always fed, a transcode slows down to a few packets in flight
+    // instead of stalling on memory held by other players and transcodes
+    [[nodiscard]] auto pipelineStarving() const -> bool
+    {
+        if (pipelineContexts.isEmpty()) {
+            return muxQueue.size() == 0;
+        }
+        return std::any_of(pipelineContexts.cbegin(),
+                           pipelineContexts.cend(),
+                           [](const auto *transCtx) { return transCtx->decodeQueue.size() == 0; });
+    }
+
+    // return false if the global memory budget is still exceeded, the stop flag has to be
+    // checked before waiting again
+    auto waitMemoryBudget() -> bool
+    {
+        auto *memoryBudget = MemoryBudget::instance();
+        if (!memoryBudget->isExceeded() || pipelineStarving()) {
+            budgetWaitTimer.invalidate();
+            return true;
+        }
+        if (!budgetWaitTimer.isValid()) {
+            budgetWaitTimer.start();
+        } else if (budgetWaitTimer.elapsed() > s_memoryBudgetStallMilliseconds) {
+            qWarning() << "Transcode waits for the memory budget, usage:"
+                       << memoryBudget->usage() << "limit:" << memoryBudget->limit();
+            budgetWaitTimer.start();
+        }
+        return memoryBudget->waitForBudget(s_waitMemoryBudgetMilliseconds);
+    }
+
+    // demuxer
+    void loop()
+    {
+        // from the key frame before the range start, the decoders drop what is before it
+        if (range.first > 0 && !inFormatContext->seekFrame(-1, rangeStart())) {
+            qWarning() << "Seek to the range start failed, demux from the beginning";
+        }
+        startPipeline();
+        while (runing.load()) {
+            if (!waitMemoryBudget()) {
+                continue;
+            }
+
+            auto packetPtr = Packet::create();
+            auto begin = av_gettime_relative();
+            if (!inFormatContext->readFrame(packetPtr)) {
+                break;
+            }
+            addStageTime(Stage::Demux, begin);
+            auto stream_index = packetPtr->streamIndex();
+            auto *transcodeCtx = transcodeContexts.at(stream_index);
+            if (!transcodeCtx->vaild) {
+                continue;
+            }
+
+            auto inTimebase = inFormatContext->stream(stream_index)->time_base;
+            auto outIndex = transcodeCtx->outStreamIndex;
+            auto *avPacket = packetPtr->avPacket();
+            if (avPacket->dts != AV_NOPTS_VALUE) {
+                auto dts = av_rescale_q(avPacket->dts, inTimebase, AV_TIME_BASE_Q);
+                if (dts >= rangeEnd()) {
+                    if (dts - rangeEnd() > s_rangeEndMargin) {
+                        break;
+                    }
+                    continue;
+                }
+                setDemuxPosition(dts);
+            }
+            if (stream_index == segmentStreamIndex) {
+                continue;
+            }
+            if (transcodeCtx->encContextInfoPtr.isNull()) {
+                auto pts = avPacket->pts != AV_NOPTS_VALUE ? avPacket->pts : avPacket->dts;
+                if (pts != AV_NOPTS_VALUE
+                    && av_rescale_q(pts, inTimebase, AV_TIME_BASE_Q) < rangeStart()) {
+                    continue;
+                }
+                for (const auto &renditionCtx : std::as_const(transcodeCtx->renditionContexts)) {
+                    auto copyPtr = std::make_shared<Packet>(*packetPtr);
+                    auto renditionIndex = renditionCtx->outStreamIndex;
+                    auto *formatContext = outputContext(renditionCtx->output);
+                    copyPtr->rescaleTs(inTimebase,
+                                       formatContext->stream(renditionIndex)->time_base);
+                    copyPtr->setStreamIndex(renditionIndex);
+                    outputQueue(renditionCtx->output).push_back(copyPtr);
+                }
+                packetPtr->rescaleTs(inTimebase, outFormatContext->stream(outIndex)->time_base);
+                packetPtr->setStreamIndex(outIndex);
+                muxQueue.push_back(packetPtr);
+            } else {
+                packetPtr->rescaleTs(inTimebase, transcodeCtx->decContextInfoPtr->timebase());
+                transcodeCtx->decodeQueue.push_back(packetPtr);
+            }
+        }
+        // also releases the segment stage when the transcode is stopped
+        setDemuxPosition(std::numeric_limits<qint64>::max());
+        if (runing.load()) {
+            for (auto *transCtx : std::as_const(pipelineContexts)) {
+                transCtx->decodeQueue.push_back(nullptr);
+            }
+            for (int i = 0; i < outputCount(); i++) {
+                outputQueue(i).push_back(nullptr);
+            }
+        } else {
+            abortPipeline();
+        }
+        stopPipeline();
+    }
+
+    void addStageTime(Stage stage, qint64 begin)
+    {
+        stageTimes.at(static_cast<size_t>(stage)) += av_gettime_relative() - begin;
+    }
+
+    void addPropertyChangeEvent(PropertyChangeEvent *event)
+    {
+        propertyChangeEventQueue.push_back(PropertyChangeEventPtr(event));
+        while (propertyChangeEventQueue.size() > maxPropertyEventQueueSize.load()) {
+            propertyChangeEventQueue.take();
+        }
+        emit q_ptr->eventIncrease();
+    }
+
+    void reset()
+    {
+        if (!transcodeContexts.isEmpty()) {
+            qDeleteAll(transcodeContexts);
+            transcodeContexts.clear();
+        }
+        inFormatContext->close();
+        outFormatContext->close();
+        for (const auto &rendition : std::as_const(renditions)) {
+            rendition.formatContext->close();
+        }
+
+        fpsPtr->reset();
+        writeSpeedPtr->reset();
+        frameCount = 0;
+        writeFailed = false;
+        for (auto &stageTime : stageTimes) {
+            stageTime = 0;
+        }
+    }
+
+    Transcoder *q_ptr;
+
+    QString inFilePath;
+    QString outFilepath;
+    FormatContext *inFormatContext;
+    FormatContext *outFormatContext;
+    QList<TranscoderContext *> transcodeContexts{};
+    QString subtitleFilename;
+
+    QPair<qint64, qint64> range;
+
+    EncodeContexts decodeContexts;
+    EncodeContexts encodeContexts;
+
+    std::atomic_bool runing = true;
+    QScopedPointer<Utils::Fps> fpsPtr;
+    QScopedPointer<Utils::Speed> writeSpeedPtr;
+    std::atomic<qint64> frameCount = 0;
+    std::atomic_bool writeFailed = false;
+
+    bool gpuDecode = true;
+
+    Utils::ConcurrentQueue<PropertyChangeEventPtr> propertyChangeEventQueue;
+    std::atomic<size_t> maxPropertyEventQueueSize = 100;
+
+    FramePtrList previewFrames;
+    QThreadPool *threadPool;
+
+    // extra outputs fed from the same decode
+    struct Rendition
+    {
+        QString filepath;
+        EncodeContexts encodeContexts;
+        QSharedPointer<FormatContext> formatContext;
+        QSharedPointer<Utils::BoundedBlockingQueue<PacketPtr>> muxQueue;
+    };
+    QList<Rendition> renditions;
+
+    QMutex pipelineMutex;
+    QList<TranscoderContext *> pipelineContexts;
+    QList<QThread *> stages;
+    Utils::BoundedBlockingQueue<PacketPtr> muxQueue;
+    QElapsedTimer budgetWaitTimer; // while the demuxer waits for the memory budget
+    int muxQueueSize = s_pipelineMuxQueueSize;
+    int ioBufferSize = 0;
+    int fpsStreamIndex = -1;
+
+    bool smartCut = false;
+    int smartCutStreamIndex = -1;
+    QList<Segment> smartCutSegments;
+
+    int segmentCount = 0;
+    qint64 segmentDuration = 0; // microsecond
+    int segmentStreamIndex = -1;
+    QStringList segmentFiles;
+    QScopedPointer<QTemporaryDir> segmentDir;
+    QMutex demuxPositionMutex;
+    QWaitCondition demuxPositionCondition;
+    qint64 demuxPosition = AV_NOPTS_VALUE; // microsecond, max when the demuxer is done
+
+    // time spent in ffmpeg per stage, without the waits on the queues
+    std::array<std::atomic<qint64>, static_cast<size_t>(Stage::Count)> stageTimes{};
+};
+
+Transcoder::Transcoder(QObject *parent)
+    : QThread{parent}
+    , d_ptr(new TranscoderPrivate(this))
+{
+    av_log_set_level(AV_LOG_INFO);
+}
+
+Transcoder::~Transcoder()
+{
+    d_ptr->threadPool->clear();
+    stopTranscode();
+}
+
+void Transcoder::setInFilePath(const QString &filePath)
+{
     d_ptr->inFilePath = filePath;
 }
 
 void Transcoder::parseInputFile()
 {
     d_ptr->reset();
-    d_ptr->threadPool->start([this] { d_ptr->openInputFile(true); });
+    d_ptr->threadPool->start([this] {
+        if (!d_ptr->openInputFile(true)) {
+            d_ptr->addPropertyChangeEvent(new ErrorEvent(tr("Open input file failed!")));
+        }
+    });
 }
 
 auto Transcoder::duration() const -> qint64
@@ -575,6 +1725,16 @@ void Transcoder::setPreviewFrames(const FramePtrList &framePtrs)
         Qt::QueuedConnection);
 }
 
+void Transcoder::setPreviewFrame(int index, int count, const FramePtr &framePtr)
+{
+    QMetaObject::invokeMethod(
+        this,
+        [this, index, count, framePtr]() {
+            d_ptr->addPropertyChangeEvent(new PreviewFrameEvent(index, count, framePtr));
+        },
+        Qt::QueuedConnection);
+}
+
 auto Transcoder::previewFrames() const -> FramePtrList
 {
     return d_ptr->previewFrames;
@@ -614,6 +1774,65 @@ void Transcoder::setRange(const QPair<qint64, qint64> &range)
     d_ptr->range = range;
 }
 
+void Transcoder::addRendition(const QString &filepath, const EncodeContexts &encodeContexts)
+{
+    for (int i = 0; i < encodeContexts.size(); i++) {
+        auto index = encodeContexts.at(i).streamIndex;
+        Q_ASSERT(i == index || index < 0);
+    }
+    TranscoderPrivate::Rendition rendition;
+    rendition.filepath = filepath;
+    rendition.encodeContexts = encodeContexts;
+    rendition.formatContext.reset(new FormatContext);
+    rendition.muxQueue.reset(new Utils::BoundedBlockingQueue<PacketPtr>);
+    d_ptr->renditions.append(rendition);
+}
+
+void Transcoder::clearRenditions()
+{
+    d_ptr->renditions.clear();
+}
+
+auto Transcoder::renditionCount() const -> int
+{
+    return d_ptr->renditions.size();
+}
+
+auto Transcoder::range() const -> QPair<qint64, qint64>
+{
+    return d_ptr->range;
+}
+
+void Transcoder::setSmartCut(bool enable)
+{
+    d_ptr->smartCut = enable;
+}
+
+auto Transcoder::isSmartCut() const -> bool
+{
+    return d_ptr->smartCut;
+}
+
+void Transcoder::setSegmentCount(int count)
+{
+    d_ptr->segmentCount = count;
+}
+
+auto Transcoder::segmentCount() const -> int
+{
+    return d_ptr->segmentCount;
+}
+
+void Transcoder::setSegmentDuration(qint64 duration)
+{
+    d_ptr->segmentDuration = duration;
+}
+
+auto Transcoder::segmentDuration() const -> qint64
+{
+    return d_ptr->segmentDuration;
+}
+
 void Transcoder::setSubtitleFilename(const QString &filename)
 {
     Q_ASSERT(QFile::exists(filename));
@@ -636,6 +1855,7 @@ void Transcoder::startTranscode()
 void Transcoder::stopTranscode()
 {
     d_ptr->runing = false;
+    d_ptr->abortPipeline();
     if (isRunning()) {
         quit();
         wait();
@@ -648,6 +1868,58 @@ auto Transcoder::fps() -> float
     return d_ptr->fpsPtr->getFps();
 }
 
+auto Transcoder::frameCount() const -> qint64
+{
+    return d_ptr->frameCount.load();
+}
+
+void Transcoder::setMuxQueueSize(int size)
+{
+    d_ptr->muxQueueSize = qMax(1, size);
+}
+
+auto Transcoder::muxQueueSize() const -> int
+{
+    return d_ptr->muxQueueSize;
+}
+
+void Transcoder::setIoBufferSize(int size)
+{
+    d_ptr->ioBufferSize = size;
+}
+
+auto Transcoder::ioBufferSize() const -> int
+{
+    return d_ptr->ioBufferSize;
+}
+
+auto Transcoder::muxQueueDepth() const -> int
+{
+    int depth = 0;
+    for (int i = 0; i < d_ptr->outputCount(); i++) {
+        depth += d_ptr->outputQueue(i).size();
+    }
+    return depth;
+}
+
+auto Transcoder::writeSpeed() const -> qint64
+{
+    return d_ptr->writeSpeedPtr->getSpeed();
+}
+
+auto Transcoder::stageTimes() const -> QMap<QString, qint64>
+{
+    using Stage = TranscoderPrivate::Stage;
+    auto stageTime = [this](Stage stage) {
+        return d_ptr->stageTimes.at(static_cast<size_t>(stage)).load();
+    };
+    return {{"demux", stageTime(Stage::Demux)},
+            {"decode", stageTime(Stage::Decode)},
+            {"filter", stageTime(Stage::Filter)},
+            {"encode", stageTime(Stage::Encode)},
+            {"mux", stageTime(Stage::Mux)}};
+}
+
 void Transcoder::setPropertyEventQueueMaxSize(size_t size)
 {
     d_ptr->maxPropertyEventQueueSize.store(size);
@@ -678,11 +1950,19 @@ void Transcoder::run()
         d_ptr->addPropertyChangeEvent(new ErrorEvent(tr("Open input file failed!")));
         return;
     }
-    if (!d_ptr->openOutputFile()) {
+    d_ptr->prepareSmartCut();
+    if (!d_ptr->openOutputFiles()) {
         d_ptr->addPropertyChangeEvent(new ErrorEvent(tr("Open ouput file failed!")));
         return;
     }
     d_ptr->initAudioFifo();
+    if (!d_ptr->transcodeSegments()) {
+        if (d_ptr->runing.load()) {
+            d_ptr->addPropertyChangeEvent(new ErrorEvent(tr("Transcode segments failed!")));
+        }
+        d_ptr->cleanup();
+        return;
+    }
     d_ptr->loop();
     d_ptr->cleanup();
 
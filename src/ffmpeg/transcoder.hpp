@@ -37,9 +37,33 @@ public:
     auto mediaInfo() -> MediaInfo;
     void startPreviewFrames(int count);
     void setPreviewFrames(const FramePtrList &framePtrs);
+    // a PreviewFrameEvent for each frame while startPreviewFrames() runs, index in [0, count)
+    void setPreviewFrame(int index, int count, const FramePtr &framePtr);
     [[nodiscard]] auto previewFrames() const -> FramePtrList;
 
+    // Extra outputs (an ABR ladder) encoded from the same decode, each with its own encoders,
+    // size and bitrate; they take the streams of the main output. The decoded frames are split
+    // in the filter graph and every rendition is encoded on its own threads
+    void addRendition(const QString &filepath, const EncodeContexts &encodeContexts);
+    void clearRenditions();
+    [[nodiscard]] auto renditionCount() const -> int;
+
+    // Only transcode [first, second) of the input, microsecond; the output starts at first.
+    // The demuxer seeks to the key frame before first and stops after second
     void setRange(const QPair<qint64, qint64> &range);
+    [[nodiscard]] auto range() const -> QPair<qint64, qint64>;
+    // Copy the whole GOPs inside the range and only transcode the partial ones at both ends, for
+    // a video encoder of the source codec and size and an output without global headers (ts, not
+    // mp4, mov or mkv)
+    void setSmartCut(bool enable);
+    [[nodiscard]] auto isSmartCut() const -> bool;
+
+    // Split the video stream at key frames and encode the parts in parallel, then stitch them
+    // into the output; a segment duration takes precedence over the count, < 2 segments disables
+    void setSegmentCount(int count);
+    [[nodiscard]] auto segmentCount() const -> int;
+    void setSegmentDuration(qint64 duration); // microsecond
+    [[nodiscard]] auto segmentDuration() const -> qint64;
 
     void setSubtitleFilename(const QString &filename);
 
@@ -47,6 +71,19 @@ public:
     void stopTranscode();
 
     auto fps() -> float;
+    [[nodiscard]] auto frameCount() const -> qint64; // decoded video frames inside the range
+
+    // The outputs are written on their own mux threads behind bounded queues, so slow disks or
+    // network shares only block encoding once a queue is full
+    void setMuxQueueSize(int size); // packets per output
+    [[nodiscard]] auto muxQueueSize() const -> int;
+    void setIoBufferSize(int size); // bytes, <= 0 keeps ffmpeg's default
+    [[nodiscard]] auto ioBufferSize() const -> int;
+    [[nodiscard]] auto muxQueueDepth() const -> int; // packets waiting in all outputs
+    [[nodiscard]] auto writeSpeed() const -> qint64; // bytes per second
+    // Busy time of the demux, decode, filter, encode and mux stages of the last transcode,
+    // summed over their threads; microsecond
+    [[nodiscard]] auto stageTimes() const -> QMap<QString, qint64>;
 
     void setPropertyEventQueueMaxSize(size_t size);
     [[nodiscard]] auto propertEventyQueueMaxSize() const -> size_t;
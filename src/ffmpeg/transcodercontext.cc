@@ -22,36 +22,46 @@ auto TranscoderContext::initFilter(const QString &filter_spec, const FramePtr &f
         return true;
     }
 
-    auto *enc_ctx = encContextInfoPtr->codecCtx()->avCodecCtx();
-    switch (decContextInfoPtr->mediaType()) {
-    case AVMEDIA_TYPE_VIDEO: {
-        filterPtr->init(AVMEDIA_TYPE_VIDEO, framePtr);
-        auto pix_fmt = encContextInfoPtr->pixfmt();
-        av_opt_set_bin(filterPtr->buffersinkCtx()->avFilterContext(),
-                       "pix_fmts",
-                       reinterpret_cast<uint8_t *>(&pix_fmt),
-                       sizeof(pix_fmt),
-                       AV_OPT_SEARCH_CHILDREN);
-    } break;
-    case AVMEDIA_TYPE_AUDIO: {
-        filterPtr->init(AVMEDIA_TYPE_AUDIO, framePtr);
-        auto *avFilterContext = filterPtr->buffersinkCtx()->avFilterContext();
-        av_opt_set_bin(avFilterContext,
-                       "sample_rates",
-                       reinterpret_cast<uint8_t *>(&enc_ctx->sample_rate),
-                       sizeof(enc_ctx->sample_rate),
-                       AV_OPT_SEARCH_CHILDREN);
-        av_opt_set_bin(avFilterContext,
-                       "sample_fmts",
-                       reinterpret_cast<uint8_t *>(&enc_ctx->sample_fmt),
-                       sizeof(enc_ctx->sample_fmt),
+    auto mediaType = decContextInfoPtr->mediaType();
+    if (mediaType != AVMEDIA_TYPE_VIDEO && mediaType != AVMEDIA_TYPE_AUDIO) {
+        return false;
+    }
+    // one sink per output, each in the format of its encoder
+    QList<AVContextInfo *> encContextInfos{encContextInfoPtr.data()};
+    for (const auto &renditionContext : std::as_const(renditionContexts)) {
+        encContextInfos.append(renditionContext->encContextInfoPtr.data());
+    }
+    filterPtr->init(mediaType, framePtr, encContextInfos.size());
+    for (int i = 0; i < encContextInfos.size(); i++) {
+        auto *encContextInfo = encContextInfos.at(i);
+        auto *avFilterContext = filterPtr->buffersinkCtx(i)->avFilterContext();
+        auto *enc_ctx = encContextInfo->codecCtx()->avCodecCtx();
+        switch (mediaType) {
+        case AVMEDIA_TYPE_VIDEO: {
+            auto pix_fmt = encContextInfo->pixfmt();
+            av_opt_set_bin(avFilterContext,
+                           "pix_fmts",
+                           reinterpret_cast<uint8_t *>(&pix_fmt),
+                           sizeof(pix_fmt),
+                           AV_OPT_SEARCH_CHILDREN);
+        } break;
+        default: {
+            av_opt_set_bin(avFilterContext,
+                           "sample_rates",
+                           reinterpret_cast<uint8_t *>(&enc_ctx->sample_rate),
+                           sizeof(enc_ctx->sample_rate),
+                           AV_OPT_SEARCH_CHILDREN);
+            av_opt_set_bin(avFilterContext,
+                           "sample_fmts",
+                           reinterpret_cast<uint8_t *>(&enc_ctx->sample_fmt),
+                           sizeof(enc_ctx->sample_fmt),
+                           AV_OPT_SEARCH_CHILDREN);
+            av_opt_set(avFilterContext,
+                       "ch_layouts",
+                       getAVChannelLayoutDescribe(enc_ctx->ch_layout).toUtf8().data(),
                        AV_OPT_SEARCH_CHILDREN);
-        av_opt_set(avFilterContext,
-                   "ch_layouts",
-                   getAVChannelLayoutDescribe(enc_ctx->ch_layout).toUtf8().data(),
-                   AV_OPT_SEARCH_CHILDREN);
-    } break;
-    default: return false;
+        } break;
+        }
     }
 
     filterPtr->config(filter_spec);
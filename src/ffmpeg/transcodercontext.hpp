@@ -1,6 +1,9 @@
 #pragma once
 
 #include "frame.hpp"
+#include "packet.hpp"
+
+#include <utils/boundedblockingqueue.hpp>
 
 #include <QSharedPointer>
 
@@ -21,10 +24,20 @@ struct TranscoderContext
     QSharedPointer<Filter> filterPtr;
 
     QSharedPointer<AudioFifo> audioFifoPtr;
-    qint64 audioPts = 0;
+    bool audioPtsValid = false; // the fifo's pts was taken from the first frame
 
     bool vaild = false;
+    int output = 0; // 0 is the main output, then the renditions
     int outStreamIndex = -1;
+
+    // the same decoded stream encoded for the renditions, fed by further outputs of filterPtr;
+    // only their encoder, audio fifo and encode queue are used
+    QList<QSharedPointer<TranscoderContext>> renditionContexts;
+
+    // pipeline, demux -> decode -> filter -> encode -> mux; an empty item ends a stage
+    Utils::BoundedBlockingQueue<PacketPtr> decodeQueue;
+    Utils::BoundedBlockingQueue<FramePtr> filterQueue;
+    Utils::BoundedBlockingQueue<FramePtr> encodeQueue;
 };
 
 } // namespace Ffmpeg
@@ -1,50 +1,123 @@
 #include "videodecoder.h"
 #include "avcontextinfo.h"
+#include "codeccontext.h"
 #include "ffmpegutils.hpp"
 #include "videodisplay.hpp"
 #include "videoformat.hpp"
 
-#include <event/seekevent.hpp>
-
 #include <QDebug>
 
 namespace Ffmpeg {
 
+// lag of the video clock behind the master clock that makes the decoder skip work
+static constexpr qint64 s_skipNonRefLag = 100 * 1000; // microsecond
+static constexpr qint64 s_skipNonKeyLag = 500 * 1000; // microsecond
+
 class VideoDecoder::VideoDecoderPrivate
 {
 public:
-    explicit VideoDecoderPrivate(VideoDecoder *q)
+    explicit VideoDecoderPrivate(VideoDecoder *q, ClockDomain *clockDomain)
         : q_ptr(q)
     {
-        decoderVideoFrame = new VideoDisplay(q_ptr);
+        decoderVideoFrame = new VideoDisplay(clockDomain, q_ptr);
+    }
+
+    enum class SkipLevel { None, NonRef, NonKey };
+
+    void setSkipLevel(SkipLevel level)
+    {
+        if (level == skipLevel) {
+            return;
+        }
+        skipLevel = level;
+        auto *codecCtx = q_ptr->m_contextInfo->codecCtx();
+        switch (skipLevel) {
+        case SkipLevel::None:
+            codecCtx->setSkipFrame(AVDISCARD_DEFAULT);
+            codecCtx->setSkipLoopFilter(AVDISCARD_DEFAULT);
+            break;
+        case SkipLevel::NonRef:
+            codecCtx->setSkipFrame(AVDISCARD_NONREF);
+            codecCtx->setSkipLoopFilter(AVDISCARD_NONREF);
+            break;
+        case SkipLevel::NonKey:
+            codecCtx->setSkipFrame(AVDISCARD_NONKEY);
+            codecCtx->setSkipLoopFilter(AVDISCARD_ALL);
+            break;
+        }
+    }
+
+    void resetSkip()
+    {
+        setSkipLevel(SkipLevel::None);
+        waitKeyFrame = false;
     }
 
-    void processEvent() const
+    // feedback from the display, raised at once and lowered with hysteresis
+    void updateSkipLevel()
     {
-        while (q_ptr->m_runing.load() && !q_ptr->m_eventQueue.isEmpty()) {
-            auto eventPtr = q_ptr->m_eventQueue.take();
-            switch (eventPtr->type()) {
-            case Event::EventType::Pause: decoderVideoFrame->addEvent(eventPtr); break;
-            case Event::EventType::Seek: {
-                auto *seekEvent = static_cast<SeekEvent *>(eventPtr.data());
-                seekEvent->countDown();
-                q_ptr->clear();
-                decoderVideoFrame->addEvent(eventPtr);
-            } break;
-            default: break;
+        auto lag = decoderVideoFrame->lag();
+        auto level = skipLevel;
+        if (lag >= s_skipNonKeyLag) {
+            level = SkipLevel::NonKey;
+        } else if (lag >= s_skipNonRefLag) {
+            if (level == SkipLevel::None || lag < s_skipNonKeyLag / 2) {
+                level = SkipLevel::NonRef;
             }
+        } else if (lag < s_skipNonRefLag / 2) {
+            level = SkipLevel::None;
+        } else if (level == SkipLevel::NonKey) {
+            level = SkipLevel::NonRef;
         }
+        setSkipLevel(level);
+    }
+
+    // drop before decodeFrame(), frames the decoder would discard or the display would be late for
+    auto skipPacket(const PacketPtr &packetPtr) -> bool
+    {
+        updateSkipLevel();
+        if (packetPtr->isKey()) {
+            waitKeyFrame = false;
+            return false;
+        }
+        auto skip = waitKeyFrame; // the references of this frame were dropped
+        switch (skipLevel) {
+        case SkipLevel::NonKey:
+            waitKeyFrame = true;
+            skip = true;
+            break;
+        case SkipLevel::NonRef: skip = skip || packetPtr->isDisposable(); break;
+        default: break;
+        }
+        if (skip) {
+            skipNum++;
+        }
+        return skip;
+    }
+
+    [[nodiscard]] auto decodeFrames(const PacketPtr &packetPtr) const -> FramePtrList
+    {
+        auto framePtrs = q_ptr->m_contextInfo->decodeFrame(packetPtr);
+        for (const auto &framePtr : std::as_const(framePtrs)) {
+            calculatePts(framePtr, q_ptr->m_contextInfo, q_ptr->m_formatContext);
+        }
+        return framePtrs;
     }
 
     VideoDecoder *q_ptr;
 
     VideoDisplay *decoderVideoFrame;
+
+    SkipLevel skipLevel = SkipLevel::None;
+    bool waitKeyFrame = false;
+    quint64 skipNum = 0;
 };
 
-VideoDecoder::VideoDecoder(QObject *parent)
-    : Decoder<PacketPtr>(parent)
-    , d_ptr(new VideoDecoderPrivate(this))
+VideoDecoder::VideoDecoder(ClockDomain *clockDomain, QObject *parent)
+    : PacketDecoder<FramePtr>(parent)
+    , d_ptr(new VideoDecoderPrivate(this, clockDomain))
 {
+    m_nextStage = d_ptr->decoderVideoFrame;
     connect(d_ptr->decoderVideoFrame,
             &VideoDisplay::positionChanged,
             this,
@@ -66,27 +139,53 @@ void VideoDecoder::setMasterClock()
     d_ptr->decoderVideoFrame->setMasterClock();
 }
 
-void VideoDecoder::runDecoder()
+void VideoDecoder::setDisplayRefreshRate(double hz)
 {
-    d_ptr->decoderVideoFrame->startDecoder(m_formatContext, m_contextInfo);
+    d_ptr->decoderVideoFrame->setRefreshRate(hz);
+}
 
-    while (m_runing) {
-        d_ptr->processEvent();
+auto VideoDecoder::displayRefreshRate() const -> double
+{
+    return d_ptr->decoderVideoFrame->refreshRate();
+}
 
-        auto packetPtr(m_queue.take());
-        if (nullptr == packetPtr) {
-            continue;
-        }
-        auto framePtrs = m_contextInfo->decodeFrame(packetPtr);
-        for (const auto &framePtr : std::as_const(framePtrs)) {
-            calculatePts(framePtr, m_contextInfo, m_formatContext);
-            d_ptr->decoderVideoFrame->append(framePtr);
-        }
+auto VideoDecoder::presentationError() const -> qint64
+{
+    return d_ptr->decoderVideoFrame->presentationError();
+}
+
+void VideoDecoder::setMaxBufferDuration(qint64 duration)
+{
+    PacketDecoder<FramePtr>::setMaxBufferDuration(duration);
+    d_ptr->decoderVideoFrame->setMaxBufferDuration(duration);
+}
+
+void VideoDecoder::setMaxBufferBytes(qint64 bytes)
+{
+    PacketDecoder<FramePtr>::setMaxBufferBytes(bytes);
+    d_ptr->decoderVideoFrame->setMaxBufferBytes(bytes);
+}
+
+void VideoDecoder::stopDecoder()
+{
+    PacketDecoder<FramePtr>::stopDecoder();
+    if (d_ptr->skipNum > 0) {
+        qInfo() << "Video Skip Packet Num:" << d_ptr->skipNum;
+        d_ptr->skipNum = 0;
     }
-    while (m_runing && d_ptr->decoderVideoFrame->size() != 0) {
-        msleep(s_waitQueueEmptyMilliseconds);
+}
+
+auto VideoDecoder::decodePacket(const PacketPtr &packetPtr) -> FramePtrList
+{
+    if (packetPtr->isValid() && d_ptr->skipPacket(packetPtr)) {
+        return {};
     }
-    d_ptr->decoderVideoFrame->stopDecoder();
+    return d_ptr->decodeFrames(packetPtr);
+}
+
+void VideoDecoder::resetDecode()
+{
+    d_ptr->resetSkip();
 }
 
 } // namespace Ffmpeg
@@ -1,28 +1,40 @@
 #pragma once
 
 #include "decoder.h"
+#include "frame.hpp"
 #include "packet.hpp"
 
 namespace Ffmpeg {
 
+class ClockDomain;
 class VideoRender;
 
-class VideoDecoder : public Decoder<PacketPtr>
+class VideoDecoder : public PacketDecoder<FramePtr>
 {
     Q_OBJECT
 public:
-    explicit VideoDecoder(QObject *parent = nullptr);
+    explicit VideoDecoder(ClockDomain *clockDomain, QObject *parent = nullptr);
     ~VideoDecoder() override;
 
     void setVideoRenders(const QList<VideoRender *> &videoRenders);
 
     void setMasterClock();
 
+    void setDisplayRefreshRate(double hz);
+    [[nodiscard]] auto displayRefreshRate() const -> double;
+    [[nodiscard]] auto presentationError() const -> qint64; // microsecond
+
+    void setMaxBufferDuration(qint64 duration) override; // microsecond
+    void setMaxBufferBytes(qint64 bytes) override;
+
+    void stopDecoder() override;
+
 signals:
     void positionChanged(qint64 position); // microsecond
 
 protected:
-    void runDecoder() override;
+    auto decodePacket(const PacketPtr &packetPtr) -> FramePtrList override;
+    void resetDecode() override;
 
 private:
     class VideoDecoderPrivate;
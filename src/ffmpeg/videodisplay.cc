@@ -6,6 +6,7 @@
 #include <videorender/videorender.hpp>
 
 #include <QDebug>
+#include <QDeadlineTimer>
 #include <QTime>
 #include <QWaitCondition>
 
@@ -15,13 +16,15 @@ extern "C" {
 
 namespace Ffmpeg {
 
+static constexpr qint64 s_spinMicroseconds = 1000; // bounded spin at the end of a frame wait
+
 class VideoDisplay::VideoDisplayPrivate
 {
 public:
-    explicit VideoDisplayPrivate(VideoDisplay *q)
+    explicit VideoDisplayPrivate(VideoDisplay *q, ClockDomain *clockDomain)
         : q_ptr(q)
     {
-        clock = new Clock(q);
+        clock = new Clock(clockDomain, q);
     }
 
     void renderFrame(const FramePtr &framePtr)
@@ -32,7 +35,7 @@ public:
         }
     }
 
-    void processEvent(bool &firstFrame) const
+    void processEvent(bool &firstFrame)
     {
         while (q_ptr->m_runing.load() && !q_ptr->m_eventQueue.isEmpty()) {
             qDebug() << "DecoderVideoFrame::processEvent";
@@ -42,16 +45,66 @@ public:
                 auto *pauseEvent = static_cast<PauseEvent *>(eventPtr.data());
                 auto paused = pauseEvent->paused();
                 clock->setPaused(paused);
+                lastPresented = 0;
+                lag.store(0);
             } break;
             case Event::EventType::Seek: {
                 q_ptr->clear();
                 firstFrame = false;
+                lastPresented = 0;
+                lag.store(0);
             }
             default: break;
             }
         }
     }
 
+    // keeps the presentation cadence on the refresh grid, e.g. 60 fps on 144 Hz
+    [[nodiscard]] auto alignToRefresh(qint64 deadline) const -> qint64
+    {
+        auto interval = refreshInterval.load();
+        if (interval <= 0 || lastPresented == 0 || deadline <= lastPresented) {
+            return deadline;
+        }
+        auto periods = qRound64(static_cast<double>(deadline - lastPresented) / interval);
+        periods = qMax(1LL, periods);
+        return lastPresented + periods * interval;
+    }
+
+    // precise-timer waits up to the last part, early or spurious wakeups wait again; the last
+    // part is spun, timer wakeups are only accurate to the OS timer slack
+    void waitUntil(qint64 deadline)
+    {
+        forever {
+            auto remaining = deadline - av_gettime_relative();
+            if (!q_ptr->m_runing.load() || remaining <= s_spinMicroseconds) {
+                break;
+            }
+            QDeadlineTimer timer(Qt::PreciseTimer);
+            timer.setPreciseRemainingTime(0,
+                                          (remaining - s_spinMicroseconds) * 1000,
+                                          Qt::PreciseTimer);
+            QMutexLocker locker(&mutex);
+            waitCondition.wait(&mutex, timer);
+        }
+        while (q_ptr->m_runing.load() && av_gettime_relative() < deadline) {
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    void recordPresentation(qint64 deadline)
+    {
+        auto now = av_gettime_relative();
+        auto error = now - deadline;
+        lastPresented = deadline;
+        presentationError.store(error);
+        if (qAbs(error) > qAbs(maxPresentationError.load())) {
+            maxPresentationError.store(error);
+        }
+        presentedFrames++;
+        presentationErrorSum += qAbs(error);
+    }
+
     VideoDisplay *q_ptr;
 
     Clock *clock;
@@ -61,11 +114,19 @@ public:
 
     QMutex mutex_render;
     QList<VideoRender *> videoRenders = {};
+
+    std::atomic<qint64> lag = 0;
+    std::atomic<qint64> refreshInterval = 0; // microsecond, 0 unknown
+    qint64 lastPresented = 0;                // deadline of the last frame, microsecond
+    std::atomic<qint64> presentationError = 0;
+    std::atomic<qint64> maxPresentationError = 0;
+    quint64 presentedFrames = 0;
+    qint64 presentationErrorSum = 0;
 };
 
-VideoDisplay::VideoDisplay(QObject *parent)
+VideoDisplay::VideoDisplay(ClockDomain *clockDomain, QObject *parent)
     : Decoder<FramePtr>(parent)
-    , d_ptr(new VideoDisplayPrivate(this))
+    , d_ptr(new VideoDisplayPrivate(this, clockDomain))
 {}
 
 VideoDisplay::~VideoDisplay()
@@ -81,7 +142,33 @@ void VideoDisplay::setVideoRenders(const QList<VideoRender *> &videoRenders)
 
 void VideoDisplay::setMasterClock()
 {
-    Clock::setMaster(d_ptr->clock);
+    d_ptr->clock->domain()->setMaster(d_ptr->clock);
+}
+
+void VideoDisplay::setRefreshRate(double hz)
+{
+    d_ptr->refreshInterval.store(hz > 0 ? qRound64(AV_TIME_BASE / hz) : 0);
+}
+
+auto VideoDisplay::refreshRate() const -> double
+{
+    auto interval = d_ptr->refreshInterval.load();
+    return interval > 0 ? static_cast<double>(AV_TIME_BASE) / interval : 0;
+}
+
+auto VideoDisplay::presentationError() const -> qint64
+{
+    return d_ptr->presentationError.load();
+}
+
+auto VideoDisplay::maxPresentationError() const -> qint64
+{
+    return d_ptr->maxPresentationError.load();
+}
+
+auto VideoDisplay::lag() const -> qint64
+{
+    return d_ptr->lag.load();
 }
 
 void VideoDisplay::runDecoder()
@@ -91,11 +178,19 @@ void VideoDisplay::runDecoder()
     }
     quint64 dropNum = 0;
     bool firstFrame = false;
+    d_ptr->lastPresented = 0;
+    d_ptr->presentedFrames = 0;
+    d_ptr->presentationErrorSum = 0;
+    d_ptr->maxPresentationError.store(0);
+    d_ptr->lag.store(0);
     while (m_runing.load()) {
         d_ptr->processEvent(firstFrame);
 
         auto framePtr(m_queue.take());
         if (nullptr == framePtr) {
+            if (isEofReached()) {
+                break;
+            }
             continue;
         }
         if (!firstFrame) {
@@ -106,24 +201,31 @@ void VideoDisplay::runDecoder()
             d_ptr->clock->reset(framePtr->pts());
         }
         auto pts = framePtr->pts();
-        d_ptr->clock->update(pts, av_gettime_relative());
+        auto now = av_gettime_relative();
+        d_ptr->clock->update(pts, now);
         qint64 delay = 0;
         if (!d_ptr->clock->getDelayWithMaster(delay)) {
             continue;
         }
+        auto isMaster = d_ptr->clock->domain()->master() == d_ptr->clock;
+        d_ptr->lag.store(!isMaster && delay < 0 ? -delay : 0);
         auto emitPosition = qScopeGuard([this, pts]() { emit positionChanged(pts); });
         if (!d_ptr->clock->adjustDelay(delay)) {
             qDebug() << "Video Delay: " << delay;
             dropNum++;
             continue;
         }
-        if (delay > 0) {
-            QMutexLocker locker(&d_ptr->mutex);
-            d_ptr->waitCondition.wait(&d_ptr->mutex, delay / 1000);
-        }
+        auto deadline = d_ptr->alignToRefresh(now + delay);
+        d_ptr->waitUntil(deadline);
         d_ptr->renderFrame(framePtr);
+        d_ptr->recordPresentation(deadline);
     }
     qInfo() << "Video Drop Num:" << dropNum;
+    if (d_ptr->presentedFrames > 0) {
+        qInfo() << "Video Presentation Error(us): mean"
+                << d_ptr->presentationErrorSum / static_cast<qint64>(d_ptr->presentedFrames)
+                << "max" << d_ptr->maxPresentationError.load();
+    }
 }
 
 } // namespace Ffmpeg
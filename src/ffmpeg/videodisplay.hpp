@@ -5,19 +5,31 @@
 
 namespace Ffmpeg {
 
+class ClockDomain;
 class VideoRender;
 
 class VideoDisplay : public Decoder<FramePtr>
 {
     Q_OBJECT
 public:
-    explicit VideoDisplay(QObject *parent = nullptr);
+    explicit VideoDisplay(ClockDomain *clockDomain, QObject *parent = nullptr);
     ~VideoDisplay() override;
 
     void setVideoRenders(const QList<VideoRender *> &videoRenders);
 
     void setMasterClock();
 
+    // frames are presented on the refresh grid when known, <= 0 means unknown
+    void setRefreshRate(double hz);
+    [[nodiscard]] auto refreshRate() const -> double;
+
+    // presented minus targeted time of the last frame, and the largest seen since start
+    [[nodiscard]] auto presentationError() const -> qint64; // microsecond
+    [[nodiscard]] auto maxPresentationError() const -> qint64; // microsecond
+
+    // how far the video clock is behind the master clock, 0 when video is the master
+    [[nodiscard]] auto lag() const -> qint64; // microsecond
+
 signals:
     void positionChanged(qint64 position); // microsecond
 
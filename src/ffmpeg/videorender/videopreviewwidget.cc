@@ -5,6 +5,7 @@
 #include <ffmpeg/codeccontext.h>
 #include <ffmpeg/decoder.h>
 #include <ffmpeg/previewtask.hpp>
+#include <ffmpeg/thumbnailcache.hpp>
 #include <ffmpeg/videodecoder.h>
 #include <ffmpeg/videoframeconverter.hpp>
 
@@ -24,7 +25,11 @@ public:
         : q_ptr(q)
     {
         threadPool = new QThreadPool(q_ptr);
-        threadPool->setMaxThreadCount(2);
+        // the requests share one session and run one after another
+        threadPool->setMaxThreadCount(1);
+        // not cleared with the requests, the sheets of a dropped session are written anyway
+        syncThreadPool = new QThreadPool(q_ptr);
+        syncThreadPool->setMaxThreadCount(1);
     }
     ~VideoPreviewWidgetPrivate()
     {
@@ -43,6 +48,8 @@ public:
     QAtomicInt taskId = 0;
     qint64 vaildCount = 0;
     QThreadPool *threadPool;
+    QThreadPool *syncThreadPool;
+    PreviewSessionPtr sessionPtr;
 };
 
 VideoPreviewWidget::VideoPreviewWidget(QWidget *parent)
@@ -55,6 +62,13 @@ VideoPreviewWidget::VideoPreviewWidget(QWidget *parent)
 VideoPreviewWidget::~VideoPreviewWidget()
 {
     clearAllTask();
+    if (!d_ptr->sessionPtr.isNull()) {
+        d_ptr->sessionPtr->abort();
+    }
+    // a running request may still insert its thumbnail
+    d_ptr->threadPool->waitForDone();
+    d_ptr->syncThreadPool->waitForDone();
+    ThumbnailCache::instance()->sync();
 }
 
 void VideoPreviewWidget::startPreview(const QString &filepath,
@@ -65,8 +79,18 @@ void VideoPreviewWidget::startPreview(const QString &filepath,
     Q_ASSERT(videoIndex >= 0);
     d_ptr->taskId.ref();
     clearAllTask();
+    // stale requests see the new task id and abort their io
+    if (d_ptr->sessionPtr.isNull() || d_ptr->sessionPtr->filepath() != filepath
+        || d_ptr->sessionPtr->videoIndex() != videoIndex) {
+        if (!d_ptr->sessionPtr.isNull()) {
+            d_ptr->sessionPtr->abort();
+            // the sprite sheets of the previous file
+            d_ptr->syncThreadPool->start([] { ThumbnailCache::instance()->sync(); });
+        }
+        d_ptr->sessionPtr.reset(new PreviewSession(filepath, videoIndex));
+    }
     d_ptr->threadPool->start(
-        new PreviewOneTask(filepath, videoIndex, timestamp, d_ptr->taskId.loadRelaxed(), this));
+        new PreviewOneTask(d_ptr->sessionPtr, timestamp, d_ptr->taskId.loadRelaxed(), this));
     d_ptr->timestamp = timestamp;
     d_ptr->duration = duration;
     d_ptr->image = QImage();
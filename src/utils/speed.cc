@@ -28,8 +28,8 @@ public:
             if (sizePoints.isEmpty()) {
                 return;
             }
+            diff = sizePoints.last().time - sizePoints.first().time;
         }
-        diff = sizePoints.last().time - sizePoints.first().time;
     }
 
     auto getSpeed() -> qint64
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "boundedblockingqueue.hpp"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+
+// Bounded single-producer/single-consumer ring queue.
+// push_back/take never lock while the queue is neither full nor empty; a blocked side parks on
+// an atomic wait that the other side only notifies when somebody is actually waiting.
+// push_back must only be called from the producer thread, take/clear from the consumer thread
+// (or while the consumer is stopped).
+// Besides the item count, the queue can be bounded by the summed duration and bytes of the
+// items pushed with a weight; minSize items are always accepted so a single huge item can't
+// stall the pipeline.
+template<typename T>
+class SpscQueue
+{
+    static_assert(is_smart_or_non_pointer<T>::value,
+                  "T must be a smart pointer or a non-pointer type.");
+
+    Q_DISABLE_COPY_MOVE(SpscQueue)
+
+    static constexpr auto s_spinCount = 64;
+
+    static auto roundUpPowerOfTwo(std::size_t value) -> std::size_t
+    {
+        std::size_t capacity = 1;
+        while (capacity < value) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    struct Weight
+    {
+        qint64 duration = 0;
+        qint64 bytes = 0;
+    };
+
+    std::vector<T> m_buffer;
+    std::vector<Weight> m_weights;
+    std::size_t m_mask = 0;
+    alignas(64) std::atomic<std::size_t> m_head{0}; // consumer
+    alignas(64) std::atomic<std::size_t> m_tail{0}; // producer
+    alignas(64) std::atomic<std::size_t> m_maxSize{1000};
+    std::atomic<std::size_t> m_minSize{2};
+    std::atomic<qint64> m_maxDuration{std::numeric_limits<qint64>::max()};
+    std::atomic<qint64> m_maxBytes{std::numeric_limits<qint64>::max()};
+    std::atomic<qint64> m_duration{0};
+    std::atomic<qint64> m_bytes{0};
+    std::atomic_bool m_abort = false;
+
+    std::atomic<quint32> m_notEmptySeq{0};
+    std::atomic<quint32> m_notFullSeq{0};
+    std::atomic_bool m_consumerWaiting = false;
+    std::atomic_bool m_producerWaiting = false;
+
+    void reserve(std::size_t max_size)
+    {
+        m_buffer.clear();
+        m_buffer.resize(roundUpPowerOfTwo(qMax<std::size_t>(max_size, 1)));
+        m_weights.assign(m_buffer.size(), Weight{});
+        m_mask = m_buffer.size() - 1;
+        m_head.store(0);
+        m_tail.store(0);
+        m_duration.store(0);
+        m_bytes.store(0);
+        m_maxSize.store(qMax<std::size_t>(max_size, 1));
+    }
+
+    void wakeConsumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumerWaiting.load(std::memory_order_relaxed)) {
+            m_notEmptySeq.fetch_add(1, std::memory_order_release);
+            m_notEmptySeq.notify_one();
+        }
+    }
+
+    void wakeProducer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_producerWaiting.load(std::memory_order_relaxed)) {
+            m_notFullSeq.fetch_add(1, std::memory_order_release);
+            m_notFullSeq.notify_one();
+        }
+    }
+
+    [[nodiscard]] auto isFull(std::size_t tail) const -> bool
+    {
+        auto size = tail - m_head.load(std::memory_order_acquire);
+        if (size >= m_maxSize.load()) {
+            return true;
+        }
+        if (size < m_minSize.load()) {
+            return false;
+        }
+        return m_duration.load(std::memory_order_acquire) >= m_maxDuration.load()
+               || m_bytes.load(std::memory_order_acquire) >= m_maxBytes.load();
+    }
+
+    // return false if aborted
+    auto waitNotFull(std::size_t tail) -> bool
+    {
+        int spin = 0;
+        while (isFull(tail)) {
+            if (m_abort.load()) {
+                return false;
+            }
+            if (spin++ < s_spinCount) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto seq = m_notFullSeq.load(std::memory_order_acquire);
+            m_producerWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (isFull(tail) && !m_abort.load()) {
+                m_notFullSeq.wait(seq, std::memory_order_acquire);
+            }
+            m_producerWaiting.store(false, std::memory_order_relaxed);
+        }
+        return !m_abort.load();
+    }
+
+    // return false if aborted
+    auto waitNotEmpty(std::size_t head) -> bool
+    {
+        int spin = 0;
+        while (head == m_tail.load(std::memory_order_acquire)) {
+            if (m_abort.load()) {
+                return false;
+            }
+            if (spin++ < s_spinCount) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto seq = m_notEmptySeq.load(std::memory_order_acquire);
+            m_consumerWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (head == m_tail.load(std::memory_order_relaxed) && !m_abort.load()) {
+                m_notEmptySeq.wait(seq, std::memory_order_acquire);
+            }
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+        }
+        return !m_abort.load();
+    }
+
+    void publish(std::size_t tail, qint64 duration, qint64 bytes)
+    {
+        m_weights[tail & m_mask] = Weight{duration, bytes};
+        m_duration.fetch_add(duration, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_release);
+        wakeConsumer();
+    }
+
+    void release(std::size_t head)
+    {
+        auto &weight = m_weights[head & m_mask];
+        m_duration.fetch_sub(weight.duration, std::memory_order_relaxed);
+        m_bytes.fetch_sub(weight.bytes, std::memory_order_relaxed);
+        weight = Weight{};
+        m_buffer[head & m_mask] = T();
+    }
+
+public:
+    SpscQueue() { reserve(m_maxSize.load()); }
+    explicit SpscQueue(std::size_t max_size) { reserve(max_size); }
+    ~SpscQueue() { abort(); }
+
+    void push_back(const T &value, qint64 duration = 0, qint64 bytes = 0)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (!waitNotFull(tail)) {
+            return;
+        }
+        m_buffer[tail & m_mask] = value;
+        publish(tail, duration, bytes);
+    }
+
+    void push_back(T &&value, qint64 duration = 0, qint64 bytes = 0)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (!waitNotFull(tail)) {
+            return;
+        }
+        m_buffer[tail & m_mask] = std::move(value);
+        publish(tail, duration, bytes);
+    }
+
+    T take()
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (!waitNotEmpty(head)) {
+            return T();
+        }
+        T value = std::move(m_buffer[head & m_mask]);
+        release(head);
+        m_head.store(head + 1, std::memory_order_release);
+        wakeProducer();
+        return value;
+    }
+
+    // consumer side, never blocks
+    auto tryTake(T &value) -> bool
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_buffer[head & m_mask]);
+        release(head);
+        m_head.store(head + 1, std::memory_order_release);
+        wakeProducer();
+        return true;
+    }
+
+    void clear()
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        auto tail = m_tail.load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            release(head);
+        }
+        m_head.store(head, std::memory_order_release);
+        wakeProducer();
+    }
+
+    [[nodiscard]] auto isEmpty() const -> bool
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] auto size() const -> int
+    {
+        auto head = m_head.load(std::memory_order_acquire);
+        auto tail = m_tail.load(std::memory_order_acquire);
+        return static_cast<int>(tail - head);
+    }
+
+    // Reallocates the ring when it grows, call it only while neither side is running.
+    void setMaxSize(std::size_t max_size)
+    {
+        if (max_size > m_buffer.size()) {
+            reserve(max_size);
+            return;
+        }
+        m_maxSize.store(qMax<std::size_t>(max_size, 1));
+        wakeProducer();
+    }
+
+    [[nodiscard]] auto maxSize() const -> std::size_t { return m_maxSize.load(); }
+
+    void setMinSize(std::size_t min_size) { m_minSize.store(min_size); }
+    [[nodiscard]] auto minSize() const -> std::size_t { return m_minSize.load(); }
+
+    void setMaxDuration(qint64 duration)
+    {
+        m_maxDuration.store(duration > 0 ? duration : std::numeric_limits<qint64>::max());
+        wakeProducer();
+    }
+    [[nodiscard]] auto maxDuration() const -> qint64 { return m_maxDuration.load(); }
+
+    void setMaxBytes(qint64 bytes)
+    {
+        m_maxBytes.store(bytes > 0 ? bytes : std::numeric_limits<qint64>::max());
+        wakeProducer();
+    }
+    [[nodiscard]] auto maxBytes() const -> qint64 { return m_maxBytes.load(); }
+
+    // sum of the weights of the queued items
+    [[nodiscard]] auto duration() const -> qint64 { return m_duration.load(); }
+    [[nodiscard]] auto bytes() const -> qint64 { return m_bytes.load(); }
+
+    [[nodiscard]] auto isFull() const -> bool { return isFull(m_tail.load()); }
+
+    void start() { m_abort.store(false); }
+
+    void abort()
+    {
+        m_abort.store(true);
+        m_notEmptySeq.fetch_add(1, std::memory_order_release);
+        m_notEmptySeq.notify_all();
+        m_notFullSeq.fetch_add(1, std::memory_order_release);
+        m_notFullSeq.notify_all();
+    }
+
+    [[nodiscard]] auto isAborted() const -> bool { return m_abort.load(); }
+};
+
+} // namespace Utils
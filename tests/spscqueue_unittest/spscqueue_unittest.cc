@@ -0,0 +1,193 @@
+#include <utils/spscqueue.hpp>
+
+#include <QThread>
+#include <QtTest>
+
+#include <atomic>
+
+// long enough for a blocked side to park on the atomic wait
+static constexpr auto s_blockMilliseconds = 100;
+static constexpr auto s_stressCount = 200000;
+
+class SpscQueueTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void fifo();
+    void blockOnFull();
+    void blockOnEmpty();
+    void abortWakesConsumer();
+    void abortWakesProducer();
+    void weightBoundedFull();
+    void stress();
+};
+
+void SpscQueueTest::fifo()
+{
+    Utils::SpscQueue<int> queue(8);
+    QVERIFY(queue.isEmpty());
+    for (int i = 1; i <= 5; ++i) {
+        queue.push_back(i);
+    }
+    QCOMPARE(queue.size(), 5);
+    for (int i = 1; i <= 5; ++i) {
+        QCOMPARE(queue.take(), i);
+    }
+    QVERIFY(queue.isEmpty());
+
+    int value = 0;
+    QVERIFY(!queue.tryTake(value));
+    queue.push_back(6);
+    QVERIFY(queue.tryTake(value));
+    QCOMPARE(value, 6);
+}
+
+void SpscQueueTest::blockOnFull()
+{
+    Utils::SpscQueue<int> queue(2);
+    queue.push_back(1);
+    queue.push_back(2);
+    QVERIFY(queue.isFull());
+
+    std::atomic_bool pushed = false;
+    QScopedPointer<QThread> producer(QThread::create([&] {
+        queue.push_back(3);
+        pushed.store(true);
+    }));
+    producer->start();
+    QThread::msleep(s_blockMilliseconds);
+    QVERIFY(!pushed.load());
+
+    QCOMPARE(queue.take(), 1);
+    QVERIFY(producer->wait(5000));
+    QVERIFY(pushed.load());
+    QCOMPARE(queue.take(), 2);
+    QCOMPARE(queue.take(), 3);
+}
+
+void SpscQueueTest::blockOnEmpty()
+{
+    Utils::SpscQueue<int> queue(4);
+    std::atomic<int> taken = 0;
+    QScopedPointer<QThread> consumer(QThread::create([&] { taken.store(queue.take()); }));
+    consumer->start();
+    QThread::msleep(s_blockMilliseconds);
+    QCOMPARE(taken.load(), 0);
+
+    queue.push_back(42);
+    QVERIFY(consumer->wait(5000));
+    QCOMPARE(taken.load(), 42);
+}
+
+void SpscQueueTest::abortWakesConsumer()
+{
+    Utils::SpscQueue<int> queue(4);
+    std::atomic<int> taken = -1;
+    QScopedPointer<QThread> consumer(QThread::create([&] { taken.store(queue.take()); }));
+    consumer->start();
+    QThread::msleep(s_blockMilliseconds);
+    QCOMPARE(taken.load(), -1);
+
+    queue.abort();
+    QVERIFY(consumer->wait(5000));
+    QCOMPARE(taken.load(), 0); // T() once aborted
+    QVERIFY(queue.isAborted());
+
+    queue.start();
+    QVERIFY(!queue.isAborted());
+    queue.push_back(7);
+    QCOMPARE(queue.take(), 7);
+}
+
+void SpscQueueTest::abortWakesProducer()
+{
+    Utils::SpscQueue<int> queue(1);
+    queue.push_back(1);
+    QVERIFY(queue.isFull());
+
+    std::atomic_bool returned = false;
+    QScopedPointer<QThread> producer(QThread::create([&] {
+        queue.push_back(2);
+        returned.store(true);
+    }));
+    producer->start();
+    QThread::msleep(s_blockMilliseconds);
+    QVERIFY(!returned.load());
+
+    queue.abort();
+    QVERIFY(producer->wait(5000));
+    QVERIFY(returned.load());
+    QCOMPARE(queue.size(), 1); // the aborted push is dropped
+}
+
+void SpscQueueTest::weightBoundedFull()
+{
+    Utils::SpscQueue<int> queue(16);
+    queue.setMinSize(2);
+    queue.setMaxBytes(100);
+
+    // below minSize items are accepted whatever their weight
+    queue.push_back(1, 0, 150);
+    QVERIFY(!queue.isFull());
+    queue.push_back(2, 0, 10);
+    QCOMPARE(queue.bytes(), 160);
+    QVERIFY(queue.isFull());
+
+    queue.setMinSize(3);
+    QVERIFY(!queue.isFull());
+    queue.setMinSize(2);
+
+    QCOMPARE(queue.take(), 1);
+    QCOMPARE(queue.bytes(), 10);
+    QVERIFY(!queue.isFull());
+
+    queue.setMaxBytes(0); // unlimited
+    queue.setMaxDuration(1000);
+    queue.push_back(3, 600, 0);
+    QVERIFY(!queue.isFull());
+    queue.push_back(4, 600, 0);
+    QCOMPARE(queue.duration(), 1200);
+    QVERIFY(queue.isFull());
+
+    queue.clear();
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.duration(), 0);
+    QCOMPARE(queue.bytes(), 0);
+    QVERIFY(!queue.isFull());
+}
+
+void SpscQueueTest::stress()
+{
+    // a small ring keeps both sides parking and waking each other
+    Utils::SpscQueue<int> queue(8);
+    queue.setMaxBytes(64);
+
+    QScopedPointer<QThread> producer(QThread::create([&] {
+        for (int i = 1; i <= s_stressCount; ++i) {
+            queue.push_back(i, 0, i % 16);
+        }
+    }));
+    bool ordered = true;
+    QScopedPointer<QThread> consumer(QThread::create([&] {
+        for (int i = 1; i <= s_stressCount; ++i) {
+            if (queue.take() != i) {
+                ordered = false;
+                return;
+            }
+        }
+    }));
+    producer->start();
+    consumer->start();
+    QVERIFY(consumer->wait(60000));
+    if (!ordered) {
+        queue.abort();
+    }
+    QVERIFY(producer->wait(60000));
+    QVERIFY(ordered);
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.bytes(), 0);
+}
+
+QTEST_GUILESS_MAIN(SpscQueueTest)
+
+#include "spscqueue_unittest.moc"